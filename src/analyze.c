@@ -0,0 +1,283 @@
+#include <string.h>
+#include "analyze.h"
+
+
+static uint16_t read_opcode(const uint8_t *ram, uint16_t address) {
+    return ram[address] << 8 | ram[address + 1];
+}
+
+
+static void add_note(RomAnalysis *analysis, AnalysisNoteKind kind, uint16_t address, uint16_t target) {
+    if (analysis->note_count < MAX_ANALYSIS_NOTES) {
+        AnalysisNote *note = &analysis->notes[analysis->note_count++];
+        note->kind = kind;
+        note->address = address;
+        note->target = target;
+    }
+}
+
+
+// Marks an address as the start of a block and queues it to be decoded
+static void add_leader(RomAnalysis *analysis, uint16_t *worklist, int *worklist_size, uint16_t address) {
+    if (address > TOTAL_RAM - 2) {
+        add_note(analysis, NOTE_OUT_OF_RANGE, address, address);
+        return;
+    }
+    if ((analysis->flags[address] & ADDR_LEADER) == 0) {
+        analysis->flags[address] |= ADDR_LEADER;
+        worklist[(*worklist_size)++] = address;
+    }
+}
+
+
+/*
+* Pass 1: decode every instruction reachable from the program start,
+* marking the code bytes and the addresses where blocks start
+*/
+static void discover_code(const uint8_t *ram, RomAnalysis *analysis) {
+    static uint16_t worklist[TOTAL_RAM];
+    int worklist_size = 0;
+
+    add_leader(analysis, worklist, &worklist_size, PROGRAM_START_ADDR);
+
+    while (worklist_size > 0) {
+        uint16_t address = worklist[--worklist_size];
+
+        while (TRUE) {
+            if (address > TOTAL_RAM - 2) {
+                add_note(analysis, NOTE_OUT_OF_RANGE, address, address);
+                break;
+            }
+            if (analysis->flags[address] & ADDR_CODE) {
+                break;
+            }
+
+            uint16_t opcode = read_opcode(ram, address);
+            OpcodeId id = decode_opcode(opcode);
+            uint16_t nnn = opcode & 0x0FFF;
+            int block_ends = TRUE;
+
+            analysis->flags[address] |= ADDR_CODE;
+            analysis->flags[address + 1] |= ADDR_OPERAND;
+
+            switch (INSTRUCTION_TABLE[id].flow) {
+                case FLOW_NEXT:
+                    block_ends = FALSE;
+                    break;
+                case FLOW_JUMP:
+                    add_leader(analysis, worklist, &worklist_size, nnn);
+                    break;
+                case FLOW_CALL:
+                    add_leader(analysis, worklist, &worklist_size, nnn);
+                    add_leader(analysis, worklist, &worklist_size, address + 2);
+                    break;
+                case FLOW_SKIP:
+                    add_leader(analysis, worklist, &worklist_size, address + 2);
+                    add_leader(analysis, worklist, &worklist_size, address + 4);
+                    break;
+                case FLOW_WAIT:
+                    // The wait loops on itself, so it is always a block of its own
+                    analysis->flags[address] |= ADDR_LEADER;
+                    add_leader(analysis, worklist, &worklist_size, address + 2);
+                    break;
+                case FLOW_INDIRECT:
+                    add_note(analysis, NOTE_INDIRECT_JUMP, address, nnn);
+                    break;
+                case FLOW_INVALID:
+                    add_note(analysis, NOTE_INVALID_OPCODE, address, opcode);
+                    break;
+                case FLOW_RETURN:
+                    break;
+            }
+
+            if (block_ends) {
+                break;
+            }
+            address += 2;
+        }
+    }
+}
+
+
+// TRUE if any address in [first, last] holds reachable code
+static int overlaps_code(const RomAnalysis *analysis, int first, int last) {
+    for (int address = first; address <= last && address < TOTAL_RAM; address++) {
+        if (analysis->flags[address] & (ADDR_CODE | ADDR_OPERAND)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/*
+* Checks the stores of one block. The I_reg is tracked as a range of
+* possible values from the start of the block, it is unknown on entry
+*/
+static void check_block_writes(const uint8_t *ram, RomAnalysis *analysis, const BasicBlock *block) {
+    int i_known = FALSE;
+    int i_low = 0;
+    int i_high = 0;
+
+    for (uint16_t address = block->start; address < block->end; address += 2) {
+        uint16_t opcode = read_opcode(ram, address);
+        OpcodeId id = decode_opcode(opcode);
+        int x = (opcode & 0x0F00) >> 8;
+        int write_size = 0;
+
+        switch (id) {
+            case OP_LD_I:
+                i_known = TRUE;
+                i_low = i_high = opcode & 0x0FFF;
+                break;
+            case OP_LD_F_VX:
+                // Always points at a font sprite
+                i_known = TRUE;
+                i_low = 0;
+                i_high = FONTSET_SIZE - 5;
+                break;
+            case OP_ADD_I_VX:
+                i_known = FALSE;
+                break;
+            case OP_LD_B_VX:
+                write_size = 3;
+                break;
+            case OP_ST_V_REGS:
+                write_size = x + 1;
+                break;
+            default:
+                break;
+        }
+
+        if (write_size > 0) {
+            if (!i_known) {
+                add_note(analysis, NOTE_UNKNOWN_WRITE, address, 0);
+            }
+            else if (overlaps_code(analysis, i_low, i_high + write_size - 1)) {
+                add_note(analysis, NOTE_CODE_WRITE, address, i_low);
+            }
+        }
+
+        // FX55 and FX65 move the I_reg past the registers they transfer, in the profiles that do
+        if (i_known && (analysis->quirks & QUIRK_INCREMENT_I) && (id == OP_ST_V_REGS || id == OP_LD_V_REGS)) {
+            i_low += x + 1;
+            i_high += x + 1;
+        }
+    }
+}
+
+
+/*
+* Pass 2: build the blocks from the leaders in address order. A block runs
+* until an instruction that changes the control flow or the next leader
+*/
+static void build_blocks(const uint8_t *ram, RomAnalysis *analysis) {
+    for (int leader = 0; leader < TOTAL_RAM - 1; leader++) {
+        if ((analysis->flags[leader] & ADDR_LEADER) == 0 || (analysis->flags[leader] & ADDR_CODE) == 0) {
+            continue;
+        }
+        if (analysis->block_count == MAX_BASIC_BLOCKS) {
+            break;
+        }
+
+        BasicBlock *block = &analysis->blocks[analysis->block_count++];
+        uint16_t address = leader;
+
+        block->start = leader;
+        block->successor_count = 0;
+
+        while (TRUE) {
+            uint16_t opcode = read_opcode(ram, address);
+            InstructionFlow flow = INSTRUCTION_TABLE[decode_opcode(opcode)].flow;
+            uint16_t next = address + 2;
+
+            block->exit_flow = flow;
+            if (flow == FLOW_JUMP) {
+                block->successors[block->successor_count++] = opcode & 0x0FFF;
+            }
+            else if (flow == FLOW_CALL) {
+                block->successors[block->successor_count++] = opcode & 0x0FFF;
+                block->successors[block->successor_count++] = next;
+            }
+            else if (flow == FLOW_SKIP) {
+                block->successors[block->successor_count++] = next;
+                block->successors[block->successor_count++] = next + 2;
+            }
+            else if (flow == FLOW_WAIT) {
+                block->successors[block->successor_count++] = address;
+                block->successors[block->successor_count++] = next;
+            }
+            else if (flow == FLOW_NEXT && next <= TOTAL_RAM - 2 && (analysis->flags[next] & ADDR_CODE)) {
+                if ((analysis->flags[next] & ADDR_LEADER) == 0) {
+                    address = next;
+                    continue;
+                }
+                // Falls through into the next block
+                block->successors[block->successor_count++] = next;
+            }
+
+            block->end = next;
+            break;
+        }
+
+        check_block_writes(ram, analysis, block);
+    }
+}
+
+
+/*
+* Analyzes the rom in ram (PROGRAM_START_ADDR to rom_end), filling
+* in the code flags, basic blocks and notes. The quirks are those the
+* rom runs with, the stores are followed as they behave under them
+*/
+void analyze_rom(const uint8_t *ram, uint16_t rom_end, uint8_t quirks, RomAnalysis *analysis) {
+    memset(analysis, 0, sizeof(RomAnalysis));
+    analysis->rom_end = rom_end;
+    analysis->quirks = quirks;
+
+    discover_code(ram, analysis);
+    build_blocks(ram, analysis);
+
+    analysis->is_cache_safe = TRUE;
+    for (int i = 0; i < analysis->note_count; i++) {
+        AnalysisNoteKind kind = analysis->notes[i].kind;
+        if (kind == NOTE_INDIRECT_JUMP || kind == NOTE_CODE_WRITE || kind == NOTE_UNKNOWN_WRITE) {
+            analysis->is_cache_safe = FALSE;
+        }
+    }
+}
+
+
+// Returns the block starting at address, or NULL if no block starts there
+const BasicBlock *find_block(const RomAnalysis *analysis, uint16_t address) {
+    int low = 0;
+    int high = analysis->block_count - 1;
+
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        const BasicBlock *block = &analysis->blocks[middle];
+
+        if (block->start == address) {
+            return block;
+        }
+        if (block->start < address) {
+            low = middle + 1;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+    return NULL;
+}
+
+
+const char *note_description(AnalysisNoteKind kind) {
+    switch (kind) {
+        case NOTE_INDIRECT_JUMP: return "indirect jump";
+        case NOTE_CODE_WRITE: return "writes into code";
+        case NOTE_UNKNOWN_WRITE: return "write to unknown address";
+        case NOTE_INVALID_OPCODE: return "invalid opcode";
+        case NOTE_OUT_OF_RANGE: return "runs past the end of ram";
+    }
+    return "unknown";
+}
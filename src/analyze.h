@@ -0,0 +1,64 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include "decode.h"
+
+/*
+*
+* Static analysis of a rom loaded into memory.
+*
+* Reachable code is discovered recursively from PROGRAM_START_ADDR by
+* following jumps, calls, skips and returns. The code is split into basic
+* blocks, everything else in the rom is data. Indirect jumps (BNNN) and
+* stores (FX55, FX33) that may write over code are reported, since they
+* make a rom unsafe for anything that caches decoded or translated code.
+*
+*/
+
+#define MAX_BASIC_BLOCKS 2048
+#define MAX_ANALYSIS_NOTES 256
+
+// Flags kept for every address in ram
+#define ADDR_CODE 0x01          // first byte of a reachable instruction
+#define ADDR_OPERAND 0x02       // second byte of a reachable instruction
+#define ADDR_LEADER 0x04        // a basic block starts here
+
+typedef struct {
+    uint16_t start;             // address of the first instruction
+    uint16_t end;               // address after the last instruction
+    uint16_t successors[2];     // statically known next blocks
+    uint8_t successor_count;
+    InstructionFlow exit_flow;  // flow of the last instruction
+} BasicBlock;
+
+typedef enum {
+    NOTE_INDIRECT_JUMP,         // BNNN, the target depends on V0
+    NOTE_CODE_WRITE,            // FX55/FX33 writes into reachable code
+    NOTE_UNKNOWN_WRITE,         // FX55/FX33 with an I_reg that is not known statically
+    NOTE_INVALID_OPCODE,        // reachable opcode that is not an instruction
+    NOTE_OUT_OF_RANGE           // execution runs past the end of ram
+} AnalysisNoteKind;
+
+typedef struct {
+    AnalysisNoteKind kind;
+    uint16_t address;           // address of the instruction
+    uint16_t target;            // first address written, for the write notes
+} AnalysisNote;
+
+typedef struct {
+    uint16_t rom_end;                           // address after the last rom byte
+    uint8_t quirks;                             // quirk profile the rom runs with
+    uint8_t flags[TOTAL_RAM];
+    BasicBlock blocks[MAX_BASIC_BLOCKS];        // sorted by start address
+    int block_count;
+    AnalysisNote notes[MAX_ANALYSIS_NOTES];
+    int note_count;
+    int is_cache_safe;                          // no indirect jumps and no writes into code
+} RomAnalysis;
+
+void analyze_rom(const uint8_t *ram, uint16_t rom_end, uint8_t quirks, RomAnalysis *analysis);
+const BasicBlock *find_block(const RomAnalysis *analysis, uint16_t address);
+const char *note_description(AnalysisNoteKind kind);
+
+
+#endif // ANALYZE_H
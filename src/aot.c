@@ -0,0 +1,119 @@
+#include "aot.h"
+#include "chip8.h"
+#include "decode.h"
+#include "memory.h"
+
+
+// Translated block starting at each address, NULL where there is none
+static const AotBlock *block_at[TOTAL_RAM];
+
+// The translated code laid out at its addresses, and which addresses hold some
+static uint8_t translated[TOTAL_RAM];
+static uint8_t is_translated[TOTAL_RAM];
+
+// OpcodeIds of the instructions of each block in order, ops_at[start] points at those of a block
+static uint8_t block_ops[TOTAL_RAM];
+static const uint8_t *ops_at[TOTAL_RAM];
+
+
+void init_aot(void) {
+    size_t used = 0;
+
+    for (int i = 0; i < AOT_BLOCK_COUNT; i++) {
+        const AotBlock *block = &AOT_BLOCKS[i];
+        size_t count = block->length / 2;
+
+        // Blocks never overlap in practice, one that does not fit is left to the interpreter
+        if (used + count > TOTAL_RAM) {continue;}
+        block_at[block->start] = block;
+        ops_at[block->start] = &block_ops[used];
+
+        for (size_t j = 0; j < count; j++) {
+            block_ops[used++] = decode_opcode(block->code[2 * j] << 8 | block->code[2 * j + 1]);
+        }
+        for (int j = 0; j < block->length; j++) {
+            translated[(block->start + j) & RAM_MASK] = block->code[j];
+            is_translated[(block->start + j) & RAM_MASK] = TRUE;
+        }
+    }
+}
+
+
+// TRUE if ram still holds the code the block was translated from
+static int block_unchanged(const Chip8 *chip8, const AotBlock *block) {
+    for (int i = 0; i < block->length; i++) {
+        if (read_ram(chip8, block->start + i) != block->code[i]) {return FALSE;}
+    }
+    return TRUE;
+}
+
+
+// The lines of ram (see written_lines) a block was translated from
+static uint64_t block_lines(const AotBlock *block) {
+    unsigned first = block->start >> RAM_LINE_SHIFT;
+    unsigned last = (block->start + block->length - 1) >> RAM_LINE_SHIFT;
+    return (~(uint64_t)0 >> (63 - last)) & (~(uint64_t)0 << first);
+}
+
+
+/*
+* Compares the translated code in the given written lines with ram. Lines
+* that still match are marked clean, a line with changed code stays
+* written and the blocks in it are compared on every entry
+*/
+static void check_written_lines(Chip8 *chip8, uint64_t lines) {
+    while (lines != 0) {
+        unsigned line = __builtin_ctzll(lines);
+        unsigned address = line << RAM_LINE_SHIFT;
+        unsigned end = address + (1 << RAM_LINE_SHIFT);
+        lines &= lines - 1;
+
+        while (address < end && (!is_translated[address] || read_ram(chip8, address) == translated[address])) {
+            address++;
+        }
+        if (address == end) {
+            chip8->written_lines &= ~((uint64_t)1 << line);
+        }
+    }
+}
+
+
+/*
+* Runs the translated block at the pc_reg if there is one, its code is
+* unchanged in ram and the quirks match, otherwise interprets a single
+* instruction.
+* Logging always uses the interpreter so every instruction is printed.
+*
+* Returns the number of instructions executed, and points ops at their
+* OpcodeIds (of the code that ran, even if it has been overwritten since)
+*/
+int execute_translated(Chip8 *chip8, int logging, const uint8_t **ops) {
+    const AotBlock *block = block_at[chip8->pc_reg & 0xFFF];
+
+    if (block != NULL && !logging && chip8->quirks == AOT_QUIRKS) {
+        uint64_t lines = block_lines(block);
+        if (chip8->written_lines & lines) {
+            check_written_lines(chip8, chip8->written_lines & lines);
+        }
+        if (!(chip8->written_lines & lines) || block_unchanged(chip8, block)) {
+            *ops = ops_at[block->start];
+            return block->run(chip8);
+        }
+    }
+
+    execute_instruction(chip8, logging);
+    *ops = &chip8->current_op_id;
+    return 1;
+}
+
+
+/*
+* The most instructions execute_translated runs from the pc_reg: the
+* length of the block there, or 1 where there is none or the quirks differ
+*/
+int translated_length(const Chip8 *chip8) {
+    const AotBlock *block = block_at[chip8->pc_reg & 0xFFF];
+
+    if (block == NULL || chip8->quirks != AOT_QUIRKS) {return 1;}
+    return block->length / 2;
+}
@@ -0,0 +1,40 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include "instructions.h"
+
+/*
+*
+* Runtime for roms translated ahead of time to C by chip8-recomp.
+*
+* The generated source defines AOT_BLOCKS, one entry per basic block of
+* the rom. A block only runs if the bytes in ram still match the bytes it
+* was translated from, anything else (BNNN targets, self modified code or
+* a different rom) falls back to the interpreter. So does everything when
+* the emulator runs with other quirks than the rom was translated for.
+* The bytes are only compared again after a write to their 64 byte line
+* of ram (written_lines), so code nobody writes to runs without a check.
+*
+*/
+
+// Runs a translated block, returns the number of instructions it executed
+typedef int (*AotBlockFunc)(Chip8 *chip8);
+
+typedef struct {
+    uint16_t start;             // address of the first instruction
+    uint16_t length;            // length of the block in bytes
+    const uint8_t *code;        // opcodes the block was translated from
+    AotBlockFunc run;
+} AotBlock;
+
+// Defined by the generated source
+extern const AotBlock AOT_BLOCKS[];
+extern const int AOT_BLOCK_COUNT;
+extern const uint8_t AOT_QUIRKS;
+
+void init_aot(void);
+int execute_translated(Chip8 *chip8, int logging, const uint8_t **ops);
+int translated_length(const Chip8 *chip8);
+
+
+#endif // AOT_H
@@ -0,0 +1,173 @@
+#include <string.h>
+#include "api.h"
+#include "memory.h"
+
+
+// Puts the system in its startup state with the rom loaded, returns FALSE if the rom is too large
+int chip8_load(Chip8 *chip8, const uint8_t *rom, size_t rom_length) {
+    init_system(chip8);
+    return load_rom_buffer(chip8, rom, rom_length);
+}
+
+
+// Sets the state of all 16 keys at once, bit i is key i (1 = pressed)
+void chip8_set_keys(Chip8 *chip8, uint16_t key_mask) {
+    chip8->keyboard = key_mask;
+}
+
+
+// State of all 16 keys, bit i is key i (1 = pressed)
+uint16_t chip8_get_keys(const Chip8 *chip8) {
+    return chip8->keyboard;
+}
+
+
+/*
+* Runs the given number of frames. The hook (if not NULL) is called after
+* each frame. Stops early if the system is no longer running, returns the
+* number of frames that were run
+*/
+int chip8_step_frames(Chip8 *chip8, int frames, Chip8FrameHook hook, void *user_data) {
+    for (int frame = 0; frame < frames; frame++) {
+        if (!chip8->is_running_flag) {
+            return frame;
+        }
+
+        run_instructions(chip8, CYCLES_PER_FRAME);
+        update_timers(chip8);
+
+        if (hook != NULL) {
+            hook(chip8, user_data);
+        }
+    }
+    return frames;
+}
+
+
+// Borrowed view of the screen, SCREEN_WIDTH * SCREEN_HEIGHT bytes of 0 or 1 in row order
+const uint8_t *chip8_get_screen(const Chip8 *chip8) {
+    return &chip8->screen[0][0];
+}
+
+
+// Packs the screen into PACKED_SCREEN_SIZE bytes, 8 pixels per byte with the leftmost pixel in the MSb
+void chip8_get_screen_packed(const Chip8 *chip8, uint8_t *packed) {
+    const uint8_t *pixels = &chip8->screen[0][0];
+
+    for (int i = 0; i < PACKED_SCREEN_SIZE; i++) {
+        packed[i] = pixels[0] << 7 | pixels[1] << 6 | pixels[2] << 5 | pixels[3] << 4 |
+                    pixels[4] << 3 | pixels[5] << 2 | pixels[6] << 1 | pixels[7];
+        pixels += 8;
+    }
+}
+
+
+uint8_t chip8_read_ram(const Chip8 *chip8, uint16_t address) {
+    return read_ram(chip8, address);
+}
+
+
+/*
+* 64 bit hash of the machine state: ram, screen, registers, stack, timers
+* and the random generator. The keys held are input, not state, and are
+* left out. Ram and the screen come from the incremental hashes, so this
+* costs the same whatever changed
+*/
+uint64_t chip8_state_hash(const Chip8 *chip8) {
+    uint64_t registers[2];
+    memcpy(registers, chip8->V, sizeof(registers));
+
+    uint64_t hash = chip8->ram_hash ^ chip8->screen_hash;
+    hash = mix_key(hash ^ registers[0]);
+    hash = mix_key(hash ^ registers[1]);
+    hash = mix_key(hash ^ ((uint64_t)chip8->I_reg << 48 | (uint64_t)chip8->pc_reg << 32 |
+                           (uint64_t)chip8->sp_reg << 16 | chip8->delay_timer << 8 | chip8->sound_timer));
+    hash = mix_key(hash ^ chip8->rng_state);
+
+    for (int i = 0; i < chip8->sp_reg && i < STACK_SIZE; i++) {
+        hash = mix_key(hash ^ chip8->stack[i]);
+    }
+    return hash;
+}
+
+
+// Creates an empty set with room for capacity hashes before it grows, returns FALSE if out of memory
+int chip8_visited_init(Chip8VisitedSet *set, size_t capacity) {
+    set->capacity = 16;
+    while (set->capacity < 2 * capacity) {
+        set->capacity *= 2;
+    }
+    set->count = 0;
+    set->has_zero = FALSE;
+    set->slots = calloc(set->capacity, sizeof(uint64_t));
+    return set->slots != NULL;
+}
+
+
+static void visited_place(uint64_t *slots, size_t capacity, uint64_t hash) {
+    size_t slot = hash & (capacity - 1);
+
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    slots[slot] = hash;
+}
+
+
+/*
+* Adds a state hash to the set. Returns TRUE if it was not in the set yet,
+* FALSE if it was, and -1 if the set could not grow
+*/
+int chip8_visited_insert(Chip8VisitedSet *set, uint64_t hash) {
+    if (hash == 0) {
+        int is_new = !set->has_zero;
+        set->has_zero = TRUE;
+        return is_new;
+    }
+
+    size_t slot = hash & (set->capacity - 1);
+    while (set->slots[slot] != 0) {
+        if (set->slots[slot] == hash) {
+            return FALSE;
+        }
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+
+    // Keep the set at most half full, probes stay short
+    if (2 * (set->count + 1) > set->capacity) {
+        size_t capacity = 2 * set->capacity;
+        uint64_t *slots = calloc(capacity, sizeof(uint64_t));
+        if (slots == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] != 0) {visited_place(slots, capacity, set->slots[i]);}
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = capacity;
+        visited_place(set->slots, set->capacity, hash);
+    }
+    else {
+        set->slots[slot] = hash;
+    }
+    set->count++;
+    return TRUE;
+}
+
+
+void chip8_visited_free(Chip8VisitedSet *set) {
+    free(set->slots);
+    set->slots = NULL;
+    set->capacity = 0;
+    set->count = 0;
+}
+
+
+/*
+* Makes child a copy of parent to run on from the same state, for example
+* to try different keys. The child has its own ram, nothing is shared
+*/
+void chip8_fork(const Chip8 *parent, Chip8 *child) {
+    memcpy(child, parent, sizeof(Chip8));
+}
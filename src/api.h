@@ -0,0 +1,52 @@
+#ifndef API_H
+#define API_H
+
+#include "chip8.h"
+
+/*
+*
+* Step based embedding API over the core, for programs that drive the
+* emulator themselves (training loops, batch runners, test harnesses).
+*
+* Nothing in here touches SDL or sleeps. A frame is CYCLES_PER_FRAME
+* instructions followed by one timer update, the same rate the SDL
+* frontend runs at.
+*
+* chip8_state_hash identifies a machine state in constant time, ram and
+* the screen are hashed incrementally as they are written. Together with
+* a Chip8VisitedSet it tells exploration code whether a state was seen.
+*
+* chip8_fork copies a running system, a Chip8 holds no pointers so the
+* child is independent of the parent from the start.
+*
+*/
+
+#define CYCLES_PER_FRAME 9                                  // ~540 Hz cpu / 60 Hz timers
+#define PACKED_SCREEN_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
+
+// Set of state hashes, open addressing with linear probing
+typedef struct {
+    uint64_t *slots;                // 0 marks an empty slot
+    size_t capacity;                // a power of 2
+    size_t count;
+    int has_zero;                   // the hash 0 is kept out of the slots
+} Chip8VisitedSet;
+
+// Called after every emulated frame, typically to read reward values out of ram
+typedef void (*Chip8FrameHook)(const Chip8 *chip8, void *user_data);
+
+int chip8_load(Chip8 *chip8, const uint8_t *rom, size_t rom_length);
+void chip8_set_keys(Chip8 *chip8, uint16_t key_mask);
+uint16_t chip8_get_keys(const Chip8 *chip8);
+int chip8_step_frames(Chip8 *chip8, int frames, Chip8FrameHook hook, void *user_data);
+const uint8_t *chip8_get_screen(const Chip8 *chip8);
+void chip8_get_screen_packed(const Chip8 *chip8, uint8_t *packed);
+uint8_t chip8_read_ram(const Chip8 *chip8, uint16_t address);
+uint64_t chip8_state_hash(const Chip8 *chip8);
+int chip8_visited_init(Chip8VisitedSet *set, size_t capacity);
+int chip8_visited_insert(Chip8VisitedSet *set, uint64_t hash);
+void chip8_visited_free(Chip8VisitedSet *set);
+void chip8_fork(const Chip8 *parent, Chip8 *child);
+
+
+#endif // API_H
@@ -0,0 +1,81 @@
+#include "audio.h"
+#include "chip8_t.h"
+
+
+static SDL_AudioDeviceID audio_device = 0;
+
+// Written by the emulation thread, read by the audio callback
+static SDL_atomic_t buzzer_on;
+
+// Only touched by the audio callback
+static uint32_t square_phase = 0;
+
+
+/*
+* SDL audio callback, runs on the audio thread.
+* Fills the buffer with a square wave while the buzzer is on and silence
+* otherwise. No locks or allocations are allowed in here.
+*/
+static void fill_audio_buffer(void *userdata, Uint8 *stream, int len) {
+    Sint16 *samples = (Sint16 *) stream;
+    int sample_count = len / (int) sizeof(Sint16);
+    const uint32_t half_period = AUDIO_SAMPLE_RATE / (BUZZER_FREQUENCY * 2);
+    (void) userdata;
+
+    if (!SDL_AtomicGet(&buzzer_on)) {
+        memset(stream, 0, len);
+        square_phase = 0;
+        return;
+    }
+
+    for (int i = 0; i < sample_count; i++) {
+        samples[i] = (square_phase < half_period) ? BUZZER_VOLUME : -BUZZER_VOLUME;
+        square_phase++;
+        if (square_phase >= half_period * 2) {
+            square_phase = 0;
+        }
+    }
+}
+
+
+/*
+* Opens the default audio device with a small fixed buffer so the buzzer
+* starts and stops within one buffer of the sound timer changing.
+* Returns FALSE if no audio device is available, the emulator runs silently then.
+*/
+int init_audio(void) {
+    SDL_AudioSpec wanted;
+    SDL_AudioSpec obtained;
+
+    SDL_AtomicSet(&buzzer_on, FALSE);
+
+    memset(&wanted, 0, sizeof(wanted));
+    wanted.freq = AUDIO_SAMPLE_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = AUDIO_BUFFER_SAMPLES;
+    wanted.callback = fill_audio_buffer;
+
+    // Allow no changes, the callback relies on the exact format and rate
+    audio_device = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, 0);
+    if (audio_device == 0) {
+        printf("Could not open SDL Audio: %s\n", SDL_GetError());
+        return FALSE;
+    }
+
+    SDL_PauseAudioDevice(audio_device, 0);
+    return TRUE;
+}
+
+
+void set_buzzer(int is_on) {
+    SDL_AtomicSet(&buzzer_on, is_on);
+}
+
+
+void close_audio(void) {
+    if (audio_device != 0) {
+        SDL_CloseAudioDevice(audio_device);
+        audio_device = 0;
+    }
+}
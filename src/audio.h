@@ -0,0 +1,22 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <SDL2/SDL.h>
+
+/*
+*
+* System buzzer. A square wave is generated on the SDL audio thread
+* while the buzzer is on, the emulation thread only flips an atomic flag.
+*
+*/
+
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_BUFFER_SAMPLES 256        // ~5.8 ms per buffer at 44.1 kHz
+#define BUZZER_FREQUENCY 440
+#define BUZZER_VOLUME 3000
+
+int init_audio(void);
+void set_buzzer(int is_on);
+void close_audio(void);
+
+#endif // AUDIO_H
@@ -1,4 +1,7 @@
+#include <string.h>
 #include "chip8.h"
+#include "quirks.h"
+#include "memory.h"
 
 
 // Load the rom into memory starting at location 0x200
@@ -23,12 +26,7 @@ void load_rom(Chip8 *chip8, const char *rom_filename) {
         fread(rom_buffer, sizeof(uint8_t), rom_length, rom); 
 
         // Check that the rom is not too large for the region in memory it is placed in
-        if ((PROGRAM_END_ADDR - PROGRAM_START_ADDR) >= rom_length) {
-            for(int i = 0; i < rom_length; i++) {
-                chip8->ram[i + 0x200] = rom_buffer[i];
-            }
-        }
-        else {
+        if (!load_rom_buffer(chip8, rom_buffer, rom_length)) {
             printf("ERROR: ROM file too large\n");
             exit(EXIT_FAILURE);
         }
@@ -44,65 +42,105 @@ void load_rom(Chip8 *chip8, const char *rom_filename) {
 }
 
 
+// Copies a rom that is already in memory to location 0x200, returns FALSE if it does not fit
+int load_rom_buffer(Chip8 *chip8, const uint8_t *rom, size_t rom_length) {
+    if ((size_t)(PROGRAM_END_ADDR - PROGRAM_START_ADDR) < rom_length) {
+        return FALSE;
+    }
+
+    chip8->written_lines = ~(uint64_t)0;
+
+    uint8_t *ram = &chip8->ram[PROGRAM_START_ADDR];
+    uint64_t hash = chip8->ram_hash;
+    for (size_t i = 0; i < rom_length; i++) {
+        hash ^= ram_key(i + PROGRAM_START_ADDR, ram[i]) ^ ram_key(i + PROGRAM_START_ADDR, rom[i]);
+        ram[i] = rom[i];
+    }
+    chip8->ram_hash = hash;
+    return TRUE;
+}
+
+
 /* 
 * Initilize the system to its startup state, all of the 
 * ram elements are set to 0, the stack is cleared, and the registers 
 * are cleared. The PC register starts execution at location 0x200
 * in memory
+*
+* Everything is zeroed with one memset, cheap enough to run before every
+* input of a fuzzer or every episode of a batch run.
 */
 void init_system(Chip8 *chip8) {
+    memset(chip8, 0, sizeof(Chip8));
 
     chip8->is_running_flag = TRUE;
-    chip8->draw_screen_flag = FALSE;
-    chip8->is_paused_flag = FALSE;
-
+    chip8->quirks = QUIRKS_LEGACY;
     chip8->pc_reg = PC_START;
-    chip8->current_op = 0;
-    chip8->sp_reg = 0;
-    chip8->I_reg = 0;
+    chip8->error = CHIP8_OK;
+    chip8->rng_state = DEFAULT_RNG_SEED;
+    chip8->written_lines = ~(uint64_t)0;
 
-    // Clear display (memory)
-    for (int i = 0; i < SCREEN_HEIGHT; i++) {
-        for (int j = 0; j < SCREEN_WIDTH; j++) {
-            chip8->screen[i][j] = 0;
-        }
+    // Load fontset into memory, the hashes of the zeroed ram and screen are 0
+    for (int i = 0; i < FONTSET_SIZE; i++) {
+        write_ram(chip8, i, FONTSET[i]);
     }
+}
 
-    // Clear stack
-    for (int i = 0; i < STACK_SIZE; i++) {
-        chip8->stack[i] = 0;
-    }
+// Fans PIXEL_KEY out over 4, 32, 256 and 2048 consecutive pixels
+#define PIXEL_KEYS_4(i) PIXEL_KEY(i), PIXEL_KEY((i) + 1), PIXEL_KEY((i) + 2), PIXEL_KEY((i) + 3)
+#define PIXEL_KEYS_32(i) PIXEL_KEYS_4(i), PIXEL_KEYS_4((i) + 4), PIXEL_KEYS_4((i) + 8), PIXEL_KEYS_4((i) + 12), \
+                         PIXEL_KEYS_4((i) + 16), PIXEL_KEYS_4((i) + 20), PIXEL_KEYS_4((i) + 24), PIXEL_KEYS_4((i) + 28)
+#define PIXEL_KEYS_256(i) PIXEL_KEYS_32(i), PIXEL_KEYS_32((i) + 32), PIXEL_KEYS_32((i) + 64), PIXEL_KEYS_32((i) + 96), \
+                          PIXEL_KEYS_32((i) + 128), PIXEL_KEYS_32((i) + 160), PIXEL_KEYS_32((i) + 192), PIXEL_KEYS_32((i) + 224)
+#define PIXEL_KEYS_2048(i) PIXEL_KEYS_256(i), PIXEL_KEYS_256((i) + 256), PIXEL_KEYS_256((i) + 512), \
+                           PIXEL_KEYS_256((i) + 768), PIXEL_KEYS_256((i) + 1024), PIXEL_KEYS_256((i) + 1280), \
+                           PIXEL_KEYS_256((i) + 1536), PIXEL_KEYS_256((i) + 1792)
+
+CHIP8_STATIC_ASSERT(SCREEN_WIDTH * SCREEN_HEIGHT == 2048, pixel_keys_cover_the_screen);
+
+const uint64_t PIXEL_KEYS[SCREEN_WIDTH * SCREEN_HEIGHT] = {PIXEL_KEYS_2048(0)};
+
+
+// Hash of ram from scratch, what chip8->ram_hash is kept equal to
+uint64_t compute_ram_hash(const Chip8 *chip8) {
+    uint64_t hash = 0;
 
-    // Clear ram
     for (int i = 0; i < TOTAL_RAM; i++) {
-        chip8->ram[i] = 0;
+        hash ^= ram_key(i, read_ram(chip8, i));
     }
+    return hash;
+}
 
-    // Clear registers
-    for (int i = 0; i < NUM_V_REGISTERS; i++) {
-        chip8->V[i] = 0;
-    }
 
-    // Load fontset into memory
-    for(int i = 0; i < FONTSET_SIZE; i++) {
-        chip8->ram[i] = FONTSET[i];
+// Hash of the screen from scratch, what chip8->screen_hash is kept equal to
+uint64_t compute_screen_hash(const Chip8 *chip8) {
+    const uint8_t *pixels = &chip8->screen[0][0];
+    uint64_t hash = 0;
+
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        if (pixels[i]) {hash ^= pixel_key(i);}
     }
+    return hash;
+}
 
-    // Set timers to 0
-    chip8->delay_timer = 0;
-    chip8->sound_timer = 0;
 
-    // Keyboard setup
-    for (int i = 0; i < NUM_KEYS; i++) {
-        chip8->keyboard[i] = FALSE;
-    }
-    chip8->was_key_pressed = FALSE;
+// Recomputes both hashes, after ram or the screen were written without write_ram or drw
+void rehash_state(Chip8 *chip8) {
+    chip8->ram_hash = compute_ram_hash(chip8);
+    chip8->screen_hash = compute_screen_hash(chip8);
+}
+
+
+// Seeds the generator behind CXKK, xorshift never leaves 0 so it is replaced with the default seed
+void seed_random(Chip8 *chip8, uint32_t seed) {
+    chip8->rng_state = seed != 0 ? seed : DEFAULT_RNG_SEED;
 }
 
 // Largely similar to the init function, however all of the ram is not cleared 
 // (so the rom does not have to be re-loaded into memory)
 void reset_system(Chip8 *chip8) {
     chip8->is_running_flag = TRUE;
+    chip8->error = CHIP8_OK;
     chip8->draw_screen_flag = FALSE;
     chip8->is_paused_flag = FALSE;
 
@@ -118,17 +156,19 @@ void reset_system(Chip8 *chip8) {
         }
     }
 
+    chip8->screen_hash = 0;
+
     // Clear ram from the fontset end (80) to the Program ram 
     for (int i = 80; i < PROGRAM_START_ADDR; i++) {
-        chip8->ram[i] = 0;
+        write_ram(chip8, i, 0);
     }
 
-    // Clear registers, keyboard and stack (all 16 each)
+    // Clear registers and stack (16 each) and the keyboard
     for (int i = 0; i < 16; i++) {
         chip8->V[i] = 0;
-        chip8->keyboard[i] = FALSE;
         chip8->stack[i] = 0;
     }
+    chip8->keyboard = 0;
     // Reset timers to 0
     chip8->delay_timer = 0;
     chip8->sound_timer = 0;
@@ -141,8 +181,8 @@ void reset_system(Chip8 *chip8) {
 */
 uint16_t fetch_opcode(Chip8 *chip8) {
     uint16_t opcode;
-    uint8_t msB = chip8->ram[chip8->pc_reg];
-    uint8_t lsB = chip8->ram[chip8->pc_reg + 1];
+    uint8_t msB = read_ram(chip8, chip8->pc_reg);
+    uint8_t lsB = read_ram(chip8, chip8->pc_reg + 1);
 
     opcode = msB << 8 | lsB;
 
@@ -150,289 +190,110 @@ uint16_t fetch_opcode(Chip8 *chip8) {
 }
 
 
-/* 
-* Calls the instruction to execute based on the fetched opcode.
+/*
+* Runs one instruction with the quirks as a compile time constant. The
+* quirk dependent instructions are inlined here, everything else goes
+* through the decode table shared with the rom analysis tools.
 *
 * If logging is enabled, the program will print the opcode and what
 * instruction was ran.
+*
+* An unrecognized opcode stops the system with CHIP8_ERROR_INVALID_OPCODE
+* in chip8->error, the pc_reg is left on it.
 */
-void execute_instruction(Chip8 *chip8, int logging) {
+QUIRK_INLINE void execute_with_quirks(Chip8 *chip8, int logging, const unsigned quirks) {
     uint16_t opcode = fetch_opcode(chip8);
+    OpcodeId id = decode_opcode(opcode);
+    const Instruction *instruction = &INSTRUCTION_TABLE[id];
     chip8->current_op = opcode;
+    chip8->current_op_id = id;
 
-    switch(opcode & 0xF000) {
-        case 0x0000:
-            switch(opcode & 0x00FF) {
-                case 0x00E0:
-                    if (logging) {printf("Instruction Clear screen (00E0)\n");}
-                    cls(chip8);
-                    break;
-
-                case 0x00EE:
-                    if (logging) {printf("Instruction Return from Subroutine (00EE)\n");}
-                    return_from_subroutine(chip8);
-                    break;
-
-                default:
-                    printf("ERROR: Unrecognized opcode 0x%X\n", opcode);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-
-        case 0x1000:
-            if (logging) {printf("Instruction Jump (1NNN)\n");}
-            jump(chip8);
-            break;
-        
-        case 0x2000:
-            if (logging) {printf("Instruction Call Subroutine (2NNN)\n");}
-            call_subroutine(chip8);
-            break;
-
-        case 0x3000:
-            if (logging) {printf("Skip next instr Vx == kk (3XKK)\n");}
-            se_Vx_kk(chip8);
-            break;
-
-        case 0x4000:
-            if (logging) {printf("Skip next instr Vx != kk (4XKK)\n");}
-            sne_Vx_kk(chip8);
-            break;
-        
-        case 0x5000:
-            if (logging) {printf("Skip next instr Vx == Vy (5XY0)\n");}
-            se_Vx_Vy(chip8);
-            break;
-
-        case 0x6000:
-            if (logging) {printf("Instruction Load Vx reg (6XKK)\n");}
-            ld_Vx(chip8);
-            break;
-
-        case 0x7000:
-            if (logging) {printf("Instruction ADD Vx reg immediate (7XKK)\n");}
-            add_Vx_imm(chip8);
-            break;
-
-        case 0x8000:
-            switch(opcode & 0x000F) {
-                case 0x0000:
-                    if (logging) {printf("Instruction Move Vy reg into Vx reg (8XY0)\n");}
-                    move_Vx_Vy(chip8);
-                    break;
-                    
-                case 0x0001:
-                    if (logging) {printf("Instruction OR (8XY1)\n");}
-                    or_Vx_Vy(chip8);
-                    break;
-
-                case 0x0002:
-                    if (logging) {printf("Instruction AND (8XY2)\n");}
-                    and_Vx_Vy(chip8);
-                    break;
-
-                case 0x0003:
-                    if (logging) {printf("Instruction XOR (8XY3)\n");}
-                    xor_Vx_Vy(chip8);
-                    break;
-
-                case 0x0004:
-                    if (logging) {printf("Instruction ADD VX VY (8XY4)\n");}
-                    add_Vx_Vy(chip8);
-                    break;
-
-                case 0x0005:
-                    if (logging) {printf("Instruction SUB VX VY (8XY5)\n");}
-                    sub_Vx_Vy(chip8);
-                    break;
-
-                case 0x0006:
-                    if (logging) {printf("Instruction SHR VX (8XY6)\n");}
-                    shr(chip8);
-                    break;
-
-                case 0x0007:
-                    if (logging) {printf("Instruction SUBN VX VY (8XY7)\n");}
-                    subn_Vx_Vy(chip8);
-                    break;
-
-                case 0x000E:
-                    if (logging) {printf("Instruction SHL VX (8XYE)\n");}
-                    shl(chip8);
-                    break;
-
-                default:
-                    printf("ERROR: Unrecognized opcode 0x%X\n", opcode);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-
-        case 0x9000:
-            if (logging) {printf("Skip next instr Vx != Vy (9XY0)\n");}
-            sne_Vx_Vy(chip8);
-            break;
-
-        case 0xA000:
-            if (logging) {printf("Instruction LDI (ANNN)\n");}
-            ldi(chip8);
-            break;
-
-        case 0xB000:
-            if (logging) {printf("Instruction JUMP + V0 (BNNN)\n");}
-            jump_V0(chip8);
-            break;
-
-        case 0xC000:
-            if (logging) {printf("Instruction RNG Vx (CXKK)\n");}
-            rnd(chip8);
-            break;
-
-        case 0xD000:
-            if (logging) {printf("Draw Sprite (DXYN)\n");}
-            drw(chip8);
-            break;
-
-        case 0xE000:
-            switch(opcode & 0x00FF) {
-                case 0x009E:
-                    if (logging) {printf("Instruction Skip next instr if key pressed (009E)\n");}
-                    skp(chip8);
-                    break;
-
-                case 0x00A1:
-                    if (logging) {printf("Instruction Skip next instr if key not pressed (00A1)\n");}
-                    sknp(chip8);
-                    break;
-
-                default:
-                    printf("ERROR: Unrecognized opcode 0x%X\n", opcode);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-
-        case 0xF000:
-            switch(opcode & 0x00FF) {
-                case 0x0007:
-                    if (logging) {printf("Instruction Load VX with Delay Timer (0007)\n");}
-                    ld_Vx_dt(chip8);
-                    break;
-
-                case 0x000A:
-                    if (logging) {printf("Instruction Wait for key press (000A)\n");}
-                    ld_Vx_k(chip8);
-                    break;
-
-                case 0x0015:
-                    if (logging) {printf("Instruction Load Delay Timer with VX (0015)\n");}
-                    ld_dt_Vx(chip8);
-                    break;
-
-                case 0x0018:
-                    if (logging) {printf("Instruction Load SOUND Timer with VX (0018)\n");}
-                    ld_st_Vx(chip8);
-                    break;
-
-                case 0x001E:
-                    if (logging) {printf("Instruction ADD Index and Vx (001E)\n");}
-                    add_i_Vx(chip8);
-                    break;
-
-                case 0x0029:
-                    if (logging) {printf("Instruction LOAD Font from VX value (0029)\n");}
-                    ld_F_Vx(chip8);
-                    break;
-
-                case 0x0033:
-                    if (logging) {printf("Instruction STORE BCD of VX value (0033)\n");}
-                    st_bcd_Vx(chip8);
-                    break;
-
-                case 0x0055:
-                    if (logging) {printf("Instruction STORE Regs V[0] - V[X] starting at I register (0055)\n");}
-                    st_V_regs(chip8);
-                    break;
-
-                case 0x0065:
-                    if (logging) {printf("Instruction LOAD Regs V[0] - V[X] starting at I register (0065)\n");}
-                    ld_V_regs(chip8);
-                    break;
-
-                default:
-                    printf("ERROR: Unrecognized opcode 0x%X\n", opcode);
-                    exit(EXIT_FAILURE);
-                }
-                break;
-
-        default:
-            printf("ERROR: Unrecognized opcode 0x%X\n", opcode);
-            exit(EXIT_FAILURE);
+    if (instruction->handler == NULL) {
+        chip8->error = CHIP8_ERROR_INVALID_OPCODE;
+        chip8->is_running_flag = FALSE;
+        return;
+    }
+
+    if (logging) {printf("%s\n", instruction->log_text);}
+
+    switch (id) {
+        case OP_OR_VX_VY: or_Vx_Vy_quirks(chip8, quirks); break;
+        case OP_AND_VX_VY: and_Vx_Vy_quirks(chip8, quirks); break;
+        case OP_XOR_VX_VY: xor_Vx_Vy_quirks(chip8, quirks); break;
+        case OP_SHR_VX: shr_quirks(chip8, quirks); break;
+        case OP_SHL_VX: shl_quirks(chip8, quirks); break;
+        case OP_JP_V0: jump_V0_quirks(chip8, quirks); break;
+        case OP_DRW: drw_quirks(chip8, quirks); break;
+        case OP_ST_V_REGS: st_V_regs_quirks(chip8, quirks); break;
+        case OP_LD_V_REGS: ld_V_regs_quirks(chip8, quirks); break;
+        default: instruction->handler(chip8); break;
     }
 }
 
 
-/* 
-* Gets user input and updates the keyboard key status based on what keys 
-* were or were not pressed.
-*
-* Also checks for key presses that have other functionality in the emulator
-*   ESC: Exit Emulator
-*   Spacebar: Pause Emulator
-*   F5: Reset Emulator
+/*
+* One interpreter per quirk combination, each with its own dispatch loop.
+* run_quirks_N runs up to count instructions and stops early if the
+* system stops running, returning the number executed
+*/
+typedef void (*ExecuteFunc)(Chip8 *chip8, int logging);
+typedef int (*RunFunc)(Chip8 *chip8, int count);
+
+#define DEFINE_INTERPRETER(quirks) \
+    static void execute_quirks_##quirks(Chip8 *chip8, int logging) { \
+        execute_with_quirks(chip8, logging, quirks); \
+    } \
+    static int run_quirks_##quirks(Chip8 *chip8, int count) { \
+        for (int i = 0; i < count; i++) { \
+            if (!chip8->is_running_flag) {return i;} \
+            execute_with_quirks(chip8, FALSE, quirks); \
+        } \
+        return count; \
+    }
+
+#define FOR_EACH_QUIRK_COMBINATION(X) \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+#define EXECUTE_ENTRY(quirks) execute_quirks_##quirks,
+#define RUN_ENTRY(quirks) run_quirks_##quirks,
+
+FOR_EACH_QUIRK_COMBINATION(DEFINE_INTERPRETER)
+
+static const ExecuteFunc EXECUTE_FUNCS[QUIRK_COMBINATIONS] = {FOR_EACH_QUIRK_COMBINATION(EXECUTE_ENTRY)};
+static const RunFunc RUN_FUNCS[QUIRK_COMBINATIONS] = {FOR_EACH_QUIRK_COMBINATION(RUN_ENTRY)};
+
+
+/*
+* Executes the instruction at the pc_reg with the quirks of the system.
+* Returns CHIP8_OK, or the Chip8Error that stopped the system
 */
-void process_user_input(Chip8 *chip8) {
-    SDL_Event e;
-    while (SDL_PollEvent(&e)) {
-
-        // Check for keys that were pressed
-        if (e.type == SDL_KEYDOWN) {
-
-            switch (e.key.keysym.sym) {
-                case SDLK_ESCAPE:
-                    chip8->is_running_flag = FALSE;
-                    break;
-
-                case SDLK_SPACE:
-                    if (chip8->is_paused_flag) {
-                        chip8->is_paused_flag = FALSE;
-                    }
-                    else {
-                        chip8->is_paused_flag = TRUE;
-                    }
-                    break;
-
-                case SDLK_F5:
-                    reset_system(chip8);
-                    break;
-
-                default:
-                    break;
-                }
-
-            // updates each key state in the keyboard array based on their pressed status (TRUE if pressed)
-            for (int i = 0; i < NUM_KEYS; i++) {
-                if (e.key.keysym.sym == KEYMAP[i]) {
-                    chip8->keyboard[i] = TRUE;
-                }
-            }
-         }
-
-         // checks for keys that were not pressed, updates their state in the keyboard to FALSE
-         if (e.type == SDL_KEYUP) {
-             for (int i = 0; i < NUM_KEYS; i++) {
-                if (e.key.keysym.sym == KEYMAP[i]) {
-                    chip8->keyboard[i] = FALSE;
-                }
-            }
-         }
-
-         // Checks for the 'x' button on the window to be pressed
-         if (e.type == SDL_QUIT) {
-            chip8->is_running_flag = FALSE;
-         } 
+int execute_instruction(Chip8 *chip8, int logging) {
+    EXECUTE_FUNCS[chip8->quirks & (QUIRK_COMBINATIONS - 1)](chip8, logging);
+    return chip8->error;
+}
+
+
+const char *chip8_error_string(int error) {
+    switch (error) {
+        case CHIP8_OK: return "No error";
+        case CHIP8_ERROR_INVALID_OPCODE: return "Unrecognized opcode";
+        case CHIP8_ERROR_STACK_OVERFLOW: return "Stack overflow";
+        case CHIP8_ERROR_STACK_UNDERFLOW: return "Stack underflow";
+        default: return "Unknown error";
     }
 }
 
 
+/*
+* Executes up to count instructions without logging, stopping early if the
+* system stops running. Returns the number of instructions executed
+*/
+int run_instructions(Chip8 *chip8, int count) {
+    return RUN_FUNCS[chip8->quirks & (QUIRK_COMBINATIONS - 1)](chip8, count);
+}
+
+
 /* 
 * Updates the system timers for the emulator
 *
@@ -479,6 +340,6 @@ void print_stack(Chip8 *chip8) {
 void print_keyboard(Chip8 *chip8) {
     // print keyboard
     for (int i = 0; i < NUM_KEYS; i++) {
-        printf("Keyboard Key %X: %i\n",i , chip8->keyboard[i]);
+        printf("Keyboard Key %X: %i\n",i , (chip8->keyboard >> i) & 1);
     }
 }
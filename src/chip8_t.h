@@ -8,9 +8,13 @@
 *
 */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define NUM_KEYS 16
 #define NUM_V_REGISTERS 16
 #define TOTAL_RAM 4096
+#define RAM_MASK (TOTAL_RAM - 1)         // addresses wrap around at 4k
 #define STACK_SIZE 16
 #define FONTSET_SIZE 80
 #define PC_START 0x200
@@ -21,12 +25,40 @@
 #define PROGRAM_START_ADDR 0x200
 #define PROGRAM_END_ADDR 0xFFF
 
+#define RAM_LINE_SHIFT 6                // written_lines tracks ram in 64 byte lines
+
 #define SCREEN_WIDTH 64
 #define SCREEN_HEIGHT 32
 
 #define TRUE 1
 #define FALSE 0
 
+// Quirks, behaviour that differs between chip8 implementations (see quirks.h)
+#define QUIRK_VF_RESET 0x01              // 8XY1, 8XY2 and 8XY3 clear V[F]
+#define QUIRK_SHIFT_VY 0x02              // 8XY6 and 8XYE shift V[Y] into V[X] instead of shifting V[X]
+#define QUIRK_INCREMENT_I 0x04           // FX55 and FX65 leave I_reg after the last register
+#define QUIRK_JUMP_VX 0x08               // BXNN jumps to XNN + V[X] instead of NNN + V[0]
+#define QUIRK_CLIP 0x10                  // sprites stop at the screen edge instead of wrapping around
+#define QUIRK_COMBINATIONS 32
+
+// Quirk profiles. Legacy is this emulator before profiles, except that 8XYE now sets V[F] to the
+// bit shifted out (it tested V[X] & 10000000 against 1, so V[F] was always 0)
+#define QUIRKS_LEGACY (QUIRK_INCREMENT_I | QUIRK_CLIP)                               // this emulator before profiles
+#define QUIRKS_VIP (QUIRK_VF_RESET | QUIRK_SHIFT_VY | QUIRK_INCREMENT_I | QUIRK_CLIP) // COSMAC VIP
+#define QUIRKS_SCHIP (QUIRK_JUMP_VX | QUIRK_CLIP)                                     // SUPER-CHIP 1.1
+#define QUIRKS_XOCHIP (QUIRK_SHIFT_VY | QUIRK_INCREMENT_I)                            // XO-CHIP
+
+
+#define DEFAULT_RNG_SEED 0x2545F491
+
+
+// Why the system stopped running, returned by execute_instruction
+typedef enum {
+    CHIP8_OK,
+    CHIP8_ERROR_INVALID_OPCODE,
+    CHIP8_ERROR_STACK_OVERFLOW,
+    CHIP8_ERROR_STACK_UNDERFLOW
+} Chip8Error;
 
 typedef struct Chip8_t Chip8;
 
@@ -51,33 +83,61 @@ const static uint8_t FONTSET[FONTSET_SIZE] = {
     };
 
 
-struct Chip8_t {
-    uint8_t ram[TOTAL_RAM];          // 4k of memory
-    uint16_t stack[STACK_SIZE];      // stack, stores up to 16 levels
+/*
+* Laid out for cache lines: everything an instruction touches besides ram
+* and the screen (registers, timers, keys, flags and hashes) is in the first 64
+* bytes, the stack and written_lines in the next line, then ram and the
+* screen each start on a line of their own. The struct is a multiple of 64
+* bytes, so this also holds in arrays of systems. The checks below the
+* struct keep it that way.
+*/
+#define CACHE_LINE_SIZE 64
 
-    // registers 
+struct Chip8_t {
+    // registers
     uint8_t V[NUM_V_REGISTERS];      // general purpose registers (0 - 14) and the carry flag register (15)
     uint16_t I_reg;                  // index register
     uint16_t pc_reg;                 // pc register
     uint16_t sp_reg;                 // stack pointer register
+    uint16_t current_op;             // current opcode being executed by the system
+
+    // keys (16)
+    uint16_t keyboard;               // bit i is set while key i is pressed
 
     // timers
     uint8_t delay_timer;
     uint8_t sound_timer;
 
-    uint16_t current_op;             // current opcode being executed by the system
-
-    // screen
-    uint8_t screen[SCREEN_HEIGHT][SCREEN_WIDTH];
-
-    // keys (16)
-    uint8_t keyboard[NUM_KEYS];
-    uint8_t was_key_pressed;
-
     // Status flags for the emulator
     uint8_t is_running_flag;
     uint8_t draw_screen_flag;
+    uint8_t quirks;                  // QUIRK_* flags the rom expects
     uint8_t is_paused_flag;
+    uint8_t error;                   // Chip8Error that stopped the system, CHIP8_OK while running
+    uint8_t was_key_pressed;
+    uint8_t key_read_flag;           // set when an instruction reads the keyboard
+    uint8_t current_op_id;           // OpcodeId (decode.h) of current_op, what the frontend charges cycles for
+
+    uint32_t rng_state;              // xorshift state behind CXKK, part of the state so runs can be replayed
+    uint64_t ram_hash;               // hashes of ram and the screen, kept up to date (see state_hash.h)
+    uint64_t screen_hash;
+
+    uint16_t stack[STACK_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));   // stack, stores up to 16 levels
+    uint64_t written_lines;          // bit i is set when ram line i was written since translated code in it was checked
+    uint8_t ram[TOTAL_RAM] __attribute__((aligned(CACHE_LINE_SIZE)));       // 4k of memory
+    uint8_t screen[SCREEN_HEIGHT][SCREEN_WIDTH] __attribute__((aligned(CACHE_LINE_SIZE)));
 };
 
+// Compile time checks, the array size is -1 (an error) if the condition does not hold
+#define CHIP8_STATIC_ASSERT(condition, name) typedef char chip8_static_assert_##name[(condition) ? 1 : -1]
+
+CHIP8_STATIC_ASSERT(offsetof(Chip8, screen_hash) + sizeof(uint64_t) <= CACHE_LINE_SIZE, hot_fields_in_first_line);
+CHIP8_STATIC_ASSERT(offsetof(Chip8, stack) == CACHE_LINE_SIZE, stack_in_second_line);
+CHIP8_STATIC_ASSERT(offsetof(Chip8, ram) % CACHE_LINE_SIZE == 0, ram_aligned);
+CHIP8_STATIC_ASSERT(offsetof(Chip8, screen) % CACHE_LINE_SIZE == 0, screen_aligned);
+CHIP8_STATIC_ASSERT(offsetof(Chip8, ram) == 2 * CACHE_LINE_SIZE, stack_and_written_lines_in_one_line);
+CHIP8_STATIC_ASSERT(sizeof(Chip8) == offsetof(Chip8, ram) + TOTAL_RAM + SCREEN_WIDTH * SCREEN_HEIGHT, no_padding_between_arrays);
+CHIP8_STATIC_ASSERT((TOTAL_RAM >> RAM_LINE_SHIFT) <= 64, lines_fit_the_mask);
+CHIP8_STATIC_ASSERT(NUM_KEYS <= 16, keys_fit_the_mask);
+
 #endif // CHIP8_T_H
\ No newline at end of file
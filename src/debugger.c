@@ -0,0 +1,597 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "debugger.h"
+#include "memory.h"
+
+/*
+* Register layout reported to the client (little endian):
+*   V0..VF   1 byte each
+*   I, PC, SP   2 bytes each
+*   DT, ST   1 byte each
+*/
+#define REGISTER_COUNT (NUM_V_REGISTERS + 5)
+#define REG_I (NUM_V_REGISTERS)
+#define REG_PC (NUM_V_REGISTERS + 1)
+#define REG_SP (NUM_V_REGISTERS + 2)
+#define REG_DT (NUM_V_REGISTERS + 3)
+#define REG_ST (NUM_V_REGISTERS + 4)
+
+static const char TARGET_XML[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.chip8.core\">"
+    "<reg name=\"v0\" bitsize=\"8\"/><reg name=\"v1\" bitsize=\"8\"/>"
+    "<reg name=\"v2\" bitsize=\"8\"/><reg name=\"v3\" bitsize=\"8\"/>"
+    "<reg name=\"v4\" bitsize=\"8\"/><reg name=\"v5\" bitsize=\"8\"/>"
+    "<reg name=\"v6\" bitsize=\"8\"/><reg name=\"v7\" bitsize=\"8\"/>"
+    "<reg name=\"v8\" bitsize=\"8\"/><reg name=\"v9\" bitsize=\"8\"/>"
+    "<reg name=\"va\" bitsize=\"8\"/><reg name=\"vb\" bitsize=\"8\"/>"
+    "<reg name=\"vc\" bitsize=\"8\"/><reg name=\"vd\" bitsize=\"8\"/>"
+    "<reg name=\"ve\" bitsize=\"8\"/><reg name=\"vf\" bitsize=\"8\"/>"
+    "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "<reg name=\"sp\" bitsize=\"16\"/>"
+    "<reg name=\"dt\" bitsize=\"8\"/>"
+    "<reg name=\"st\" bitsize=\"8\"/>"
+    "</feature>"
+    "</target>";
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+
+static int test_bit(const uint64_t *bitmap, uint16_t address) {
+    return (bitmap[address >> 6] >> (address & 63)) & 1;
+}
+
+
+static void update_armed(Debugger *debugger) {
+    debugger->is_armed = debugger->breakpoint_count > 0 || debugger->watchpoint_count > 0 ||
+                         debugger->single_step || debugger->is_stopped;
+}
+
+
+void set_breakpoint(Debugger *debugger, uint16_t address, int enabled) {
+    address &= 0xFFF;
+    uint64_t bit = (uint64_t)1 << (address & 63);
+    int was_set = test_bit(debugger->breakpoints, address);
+
+    if (enabled && !was_set) {
+        debugger->breakpoints[address >> 6] |= bit;
+        debugger->breakpoint_count++;
+    }
+    else if (!enabled && was_set) {
+        debugger->breakpoints[address >> 6] &= ~bit;
+        debugger->breakpoint_count--;
+    }
+    update_armed(debugger);
+}
+
+
+void set_watchpoint(Debugger *debugger, uint16_t address, int length, int enabled) {
+    for (int i = 0; i < length; i++) {
+        uint16_t watched = (address + i) & 0xFFF;
+        uint64_t bit = (uint64_t)1 << (watched & 63);
+        int was_set = test_bit(debugger->watchpoints, watched);
+
+        if (enabled && !was_set) {
+            debugger->watchpoints[watched >> 6] |= bit;
+            debugger->watchpoint_count++;
+        }
+        else if (!enabled && was_set) {
+            debugger->watchpoints[watched >> 6] &= ~bit;
+            debugger->watchpoint_count--;
+        }
+    }
+    update_armed(debugger);
+}
+
+
+static void stop(Debugger *debugger, StopReason reason) {
+    debugger->is_stopped = TRUE;
+    debugger->single_step = FALSE;
+    debugger->stop_reason = reason;
+    update_armed(debugger);
+}
+
+
+/*
+* Returns the first watched address the instruction at the pc_reg is about
+* to write, or -1 if it does not write a watched address. Only FX33 and
+* FX55 write to ram.
+*/
+static int watched_write(const Debugger *debugger, const Chip8 *chip8) {
+    uint16_t opcode = read_ram(chip8, chip8->pc_reg) << 8 | read_ram(chip8, chip8->pc_reg + 1);
+    int length;
+
+    switch (decode_opcode(opcode)) {
+        case OP_LD_B_VX: length = 3; break;
+        case OP_ST_V_REGS: length = ((opcode & 0x0F00) >> 8) + 1; break;
+        default: return -1;
+    }
+
+    for (int i = 0; i < length; i++) {
+        uint16_t address = (chip8->I_reg + i) & 0xFFF;
+        if (test_bit(debugger->watchpoints, address)) {
+            return address;
+        }
+    }
+    return -1;
+}
+
+
+/*
+* Checked replacement for execute_instruction, used while the debugger is
+* armed. Stops before an instruction at a breakpoint and after an
+* instruction that wrote a watched address or completed a single step.
+*
+* Returns the number of instructions executed (0 while stopped)
+*/
+int debugger_execute(Debugger *debugger, Chip8 *chip8, int logging) {
+    if (debugger->is_stopped) {
+        return 0;
+    }
+
+    if (test_bit(debugger->breakpoints, chip8->pc_reg & 0xFFF) && !debugger->resume_over_breakpoint) {
+        stop(debugger, STOP_BREAKPOINT);
+        return 0;
+    }
+    debugger->resume_over_breakpoint = FALSE;
+
+    int watch_address = debugger->watchpoint_count > 0 ? watched_write(debugger, chip8) : -1;
+
+    execute_instruction(chip8, logging);
+
+    if (watch_address >= 0) {
+        debugger->watch_address = watch_address;
+        stop(debugger, STOP_WATCHPOINT);
+    }
+    else if (debugger->single_step) {
+        stop(debugger, STOP_STEP);
+    }
+    return 1;
+}
+
+
+/*
+*
+* GDB remote serial protocol
+*
+*/
+
+static int hex_value(char digit) {
+    if (digit >= '0' && digit <= '9') {return digit - '0';}
+    if (digit >= 'a' && digit <= 'f') {return digit - 'a' + 10;}
+    if (digit >= 'A' && digit <= 'F') {return digit - 'A' + 10;}
+    return -1;
+}
+
+
+// Parses a hex number and advances the text pointer past it
+static unsigned long parse_hex(const char **text) {
+    unsigned long value = 0;
+    int digit;
+
+    while ((digit = hex_value(**text)) >= 0) {
+        value = (value << 4) | digit;
+        (*text)++;
+    }
+    return value;
+}
+
+
+static char *put_hex_byte(char *out, uint8_t value) {
+    *out++ = HEX_DIGITS[value >> 4];
+    *out++ = HEX_DIGITS[value & 0xF];
+    return out;
+}
+
+
+// Writes a packet to the client, blocking until all of it is sent
+static void send_packet(Debugger *debugger, const char *data) {
+    static char frame[DEBUGGER_PACKET_SIZE * 2 + 4];
+    uint8_t checksum = 0;
+    size_t length = 0;
+
+    frame[length++] = '$';
+    for (const char *c = data; *c != '\0' && length < sizeof(frame) - 4; c++) {
+        frame[length++] = *c;
+        checksum += (uint8_t)*c;
+    }
+    frame[length++] = '#';
+    put_hex_byte(&frame[length], checksum);
+    length += 2;
+
+    size_t sent = 0;
+    while (sent < length) {
+        ssize_t result = send(debugger->client_fd, frame + sent, length - sent, 0);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            struct pollfd writable = {debugger->client_fd, POLLOUT, 0};
+            poll(&writable, 1, 100);
+            continue;
+        }
+        if (result <= 0) {
+            return;
+        }
+        sent += result;
+    }
+}
+
+
+static void send_stop_reply(Debugger *debugger) {
+    char reply[32];
+
+    if (debugger->stop_reason == STOP_WATCHPOINT) {
+        snprintf(reply, sizeof(reply), "T05watch:%x;", debugger->watch_address);
+    }
+    else {
+        snprintf(reply, sizeof(reply), "S05");
+    }
+    send_packet(debugger, reply);
+}
+
+
+// Returns the value and byte size of register n, or 0 bytes if there is no such register
+static int read_register(const Chip8 *chip8, unsigned n, uint16_t *value) {
+    if (n < NUM_V_REGISTERS) {*value = chip8->V[n]; return 1;}
+    switch (n) {
+        case REG_I: *value = chip8->I_reg; return 2;
+        case REG_PC: *value = chip8->pc_reg; return 2;
+        case REG_SP: *value = chip8->sp_reg; return 2;
+        case REG_DT: *value = chip8->delay_timer; return 1;
+        case REG_ST: *value = chip8->sound_timer; return 1;
+        default: return 0;
+    }
+}
+
+
+static void write_register(Chip8 *chip8, unsigned n, uint16_t value) {
+    if (n < NUM_V_REGISTERS) {chip8->V[n] = value; return;}
+    switch (n) {
+        case REG_I: chip8->I_reg = value; break;
+        case REG_PC: chip8->pc_reg = value & 0xFFF; break;
+        case REG_SP: chip8->sp_reg = value; break;
+        case REG_DT: chip8->delay_timer = value; break;
+        case REG_ST: chip8->sound_timer = value; break;
+    }
+}
+
+
+static char *put_register(char *out, const Chip8 *chip8, unsigned n) {
+    uint16_t value;
+    int size = read_register(chip8, n, &value);
+
+    for (int i = 0; i < size; i++) {
+        out = put_hex_byte(out, value >> (8 * i));
+    }
+    return out;
+}
+
+
+// Reads a little endian register value of the given byte size, returns FALSE if it is malformed
+static int parse_register(const char **text, int size, uint16_t *value) {
+    *value = 0;
+    for (int i = 0; i < size; i++) {
+        int high = hex_value((*text)[0]);
+        int low = high >= 0 ? hex_value((*text)[1]) : -1;
+        if (low < 0) {
+            return FALSE;
+        }
+        *value |= (uint16_t)(high << 4 | low) << (8 * i);
+        *text += 2;
+    }
+    return TRUE;
+}
+
+
+static void handle_breakpoint_packet(Debugger *debugger, const char *args, int enabled) {
+    int type = args[0] - '0';
+    const char *text = args + 1;
+
+    if (*text++ != ',') {send_packet(debugger, "E01"); return;}
+    unsigned long address = parse_hex(&text);
+    if (*text++ != ',') {send_packet(debugger, "E01"); return;}
+    unsigned long length = parse_hex(&text);
+
+    switch (type) {
+        case 0:     // software and hardware breakpoints are the same thing here
+        case 1:
+            set_breakpoint(debugger, address, enabled);
+            break;
+        case 2:     // write watchpoint, it has to lie within ram
+            if (length == 0 || address > TOTAL_RAM || length > TOTAL_RAM - address) {
+                send_packet(debugger, "E01");
+                return;
+            }
+            set_watchpoint(debugger, address, length, enabled);
+            break;
+        default:    // read and access watchpoints are not supported
+            send_packet(debugger, "");
+            return;
+    }
+    send_packet(debugger, "OK");
+}
+
+
+static void handle_packet(Debugger *debugger, Chip8 *chip8, const char *packet) {
+    static char reply[DEBUGGER_PACKET_SIZE];
+    const char *args = packet + 1;
+    char *out = reply;
+
+    switch (packet[0]) {
+        case '?':
+            send_stop_reply(debugger);
+            return;
+
+        case 'g':
+            for (unsigned n = 0; n < REGISTER_COUNT; n++) {
+                out = put_register(out, chip8, n);
+            }
+            *out = '\0';
+            send_packet(debugger, reply);
+            return;
+
+        case 'G':
+            for (unsigned n = 0; n < REGISTER_COUNT; n++) {
+                uint16_t value;
+                if (!parse_register(&args, read_register(chip8, n, &value), &value)) {
+                    send_packet(debugger, "E01");
+                    return;
+                }
+                write_register(chip8, n, value);
+            }
+            send_packet(debugger, "OK");
+            return;
+
+        case 'p': {
+            unsigned long n = parse_hex(&args);
+            if (n >= REGISTER_COUNT) {send_packet(debugger, "E01"); return;}
+            *put_register(out, chip8, n) = '\0';
+            send_packet(debugger, reply);
+            return;
+        }
+
+        case 'P': {
+            unsigned long n = parse_hex(&args);
+            uint16_t value;
+            if (n >= REGISTER_COUNT || *args++ != '=' ||
+                !parse_register(&args, read_register(chip8, n, &value), &value)) {
+                send_packet(debugger, "E01");
+                return;
+            }
+            write_register(chip8, n, value);
+            send_packet(debugger, "OK");
+            return;
+        }
+
+        case 'm': {
+            uint16_t address = parse_hex(&args);
+            if (*args++ != ',') {send_packet(debugger, "E01"); return;}
+            unsigned long length = parse_hex(&args);
+            if (length > (DEBUGGER_PACKET_SIZE - 1) / 2) {length = (DEBUGGER_PACKET_SIZE - 1) / 2;}
+            for (unsigned long i = 0; i < length; i++) {
+                out = put_hex_byte(out, read_ram(chip8, address + i));
+            }
+            *out = '\0';
+            send_packet(debugger, reply);
+            return;
+        }
+
+        case 'M': {
+            uint16_t address = parse_hex(&args);
+            if (*args++ != ',') {send_packet(debugger, "E01"); return;}
+            unsigned long length = parse_hex(&args);
+            if (*args++ != ':') {send_packet(debugger, "E01"); return;}
+            for (unsigned long i = 0; i < length; i++) {
+                uint16_t value;
+                if (!parse_register(&args, 1, &value)) {send_packet(debugger, "E01"); return;}
+                write_ram(chip8, address + i, value);
+            }
+            send_packet(debugger, "OK");
+            return;
+        }
+
+        case 'c':
+        case 's':
+            if (*args != '\0') {
+                chip8->pc_reg = parse_hex(&args) & 0xFFF;
+            }
+            debugger->is_stopped = FALSE;
+            debugger->single_step = packet[0] == 's';
+            debugger->resume_over_breakpoint = TRUE;
+            update_armed(debugger);
+            return;     // the stop reply is sent when execution stops again
+
+        case 'Z':
+        case 'z':
+            handle_breakpoint_packet(debugger, args, packet[0] == 'Z');
+            return;
+
+        case 'H':
+            send_packet(debugger, "OK");
+            return;
+
+        case 'k':
+            chip8->is_running_flag = FALSE;
+            return;
+
+        case 'D':
+            memset(debugger->breakpoints, 0, sizeof(debugger->breakpoints));
+            memset(debugger->watchpoints, 0, sizeof(debugger->watchpoints));
+            debugger->breakpoint_count = 0;
+            debugger->watchpoint_count = 0;
+            debugger->is_stopped = FALSE;
+            debugger->single_step = FALSE;
+            update_armed(debugger);
+            send_packet(debugger, "OK");
+            close(debugger->client_fd);
+            debugger->client_fd = -1;
+            return;
+
+        case 'q':
+            if (strncmp(packet, "qSupported", 10) == 0) {
+                // The packet buffer also holds the '$' and the '#XX' checksum
+                snprintf(reply, sizeof(reply), "PacketSize=%x;qXfer:features:read+", DEBUGGER_PACKET_SIZE - 4);
+                send_packet(debugger, reply);
+            }
+            else if (strcmp(packet, "qAttached") == 0) {
+                send_packet(debugger, "1");
+            }
+            else if (strncmp(packet, "qXfer:features:read:target.xml:", 31) == 0) {
+                const char *text = packet + 31;
+                unsigned long offset = parse_hex(&text);
+                unsigned long length = *text++ == ',' ? parse_hex(&text) : 0;
+                unsigned long total = sizeof(TARGET_XML) - 1;
+
+                if (offset >= total) {
+                    send_packet(debugger, "l");
+                    return;
+                }
+                if (length > total - offset) {length = total - offset;}
+                if (length > sizeof(reply) - 2) {length = sizeof(reply) - 2;}
+                reply[0] = offset + length < total ? 'm' : 'l';
+                memcpy(reply + 1, TARGET_XML + offset, length);
+                reply[length + 1] = '\0';
+                send_packet(debugger, reply);
+            }
+            else {
+                send_packet(debugger, "");
+            }
+            return;
+
+        default:
+            send_packet(debugger, "");     // unsupported
+            return;
+    }
+}
+
+
+/*
+* Opens the stub on 127.0.0.1:port. The emulator starts stopped at the
+* first instruction and waits for a client to connect and continue.
+* Returns FALSE if the socket could not be opened
+*/
+int init_debugger(Debugger *debugger, int port) {
+    memset(debugger, 0, sizeof(Debugger));
+    debugger->client_fd = -1;
+
+    debugger->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (debugger->listen_fd < 0) {
+        perror("ERROR: Could not create debugger socket");
+        return FALSE;
+    }
+
+    int reuse = 1;
+    setsockopt(debugger->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(debugger->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(debugger->listen_fd, 1) != 0) {
+        perror("ERROR: Could not listen on debugger port");
+        close(debugger->listen_fd);
+        return FALSE;
+    }
+    fcntl(debugger->listen_fd, F_SETFL, O_NONBLOCK);
+
+    printf("Waiting for gdb on localhost:%i\n", port);
+    stop(debugger, STOP_ATTACH);
+    return TRUE;
+}
+
+
+/*
+* Services the client without blocking: accepts a new connection, handles
+* every complete packet that has arrived and sends the stop reply when the
+* emulator stopped since the last call
+*/
+void poll_debugger(Debugger *debugger, Chip8 *chip8) {
+    static StopReason reported = STOP_NONE;
+
+    if (debugger->client_fd < 0) {
+        debugger->client_fd = accept(debugger->listen_fd, NULL, NULL);
+        if (debugger->client_fd < 0) {
+            return;
+        }
+        int no_delay = 1;
+        setsockopt(debugger->client_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        fcntl(debugger->client_fd, F_SETFL, O_NONBLOCK);
+        debugger->packet_length = 0;
+        reported = debugger->is_stopped ? debugger->stop_reason : STOP_NONE;
+    }
+
+    char input[512];
+    ssize_t received;
+    while ((received = recv(debugger->client_fd, input, sizeof(input), 0)) > 0) {
+        for (ssize_t i = 0; i < received && debugger->client_fd >= 0; i++) {
+            char c = input[i];
+
+            // Ctrl-C from the client interrupts a running target
+            if (c == 0x03 && debugger->packet_length == 0) {
+                if (!debugger->is_stopped) {stop(debugger, STOP_ATTACH);}
+                continue;
+            }
+            if (debugger->packet_length == 0 && c != '$') {
+                continue;   // acks and noise between packets
+            }
+            // A packet longer than the PacketSize we told the client is dropped, the bytes up to
+            // the next '$' are skipped like noise
+            if (debugger->packet_length == DEBUGGER_PACKET_SIZE) {
+                debugger->packet_length = 0;
+                continue;
+            }
+            debugger->packet[debugger->packet_length++] = c;
+
+            // A packet ends with #XX, the checksum is trusted over a local socket
+            if (debugger->packet_length >= 4 && debugger->packet[debugger->packet_length - 3] == '#') {
+                debugger->packet[debugger->packet_length - 3] = '\0';
+                debugger->packet_length = 0;
+                send(debugger->client_fd, "+", 1, 0);
+                handle_packet(debugger, chip8, debugger->packet + 1);
+                reported = debugger->is_stopped ? debugger->stop_reason : STOP_NONE;
+            }
+        }
+        if (debugger->client_fd < 0) {
+            return;
+        }
+    }
+
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        // The client went away, keep running without it
+        close(debugger->client_fd);
+        debugger->client_fd = -1;
+        debugger->is_stopped = FALSE;
+        debugger->single_step = FALSE;
+        update_armed(debugger);
+        return;
+    }
+
+    // Report a stop that happened while running
+    if (debugger->is_stopped && reported == STOP_NONE) {
+        send_stop_reply(debugger);
+        reported = debugger->stop_reason;
+    }
+}
+
+
+void close_debugger(Debugger *debugger) {
+    if (debugger->client_fd >= 0) {
+        send_packet(debugger, "W00");
+        close(debugger->client_fd);
+    }
+    close(debugger->listen_fd);
+}
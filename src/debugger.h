@@ -0,0 +1,60 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "chip8.h"
+
+/*
+*
+* Rom debugger with a GDB remote serial protocol stub.
+*
+* Breakpoints are kept in a bitmap with one bit per pc address and
+* watchpoints in a bitmap with one bit per ram address, so checking them
+* costs a shift and a mask. The checked path (debugger_execute) is only
+* taken while something is armed; otherwise the emulator runs the plain
+* execute_instruction path and is exactly as fast as without a debugger.
+*
+* The stub listens on 127.0.0.1 and accepts one client:
+*   (gdb) target remote localhost:PORT
+*
+*/
+
+#define DEBUGGER_BITMAP_WORDS (TOTAL_RAM / 64)
+#define DEBUGGER_PACKET_SIZE 4096
+
+typedef enum {
+    STOP_NONE,
+    STOP_ATTACH,            // a client connected or sent an interrupt
+    STOP_BREAKPOINT,
+    STOP_WATCHPOINT,
+    STOP_STEP
+} StopReason;
+
+typedef struct {
+    uint64_t breakpoints[DEBUGGER_BITMAP_WORDS];    // bit per pc address
+    uint64_t watchpoints[DEBUGGER_BITMAP_WORDS];    // bit per ram address written by FX55/FX33
+    int breakpoint_count;
+    int watchpoint_count;
+
+    int is_armed;                   // TRUE if the checked execution path is needed
+    int is_stopped;                 // execution halted, waiting for the client
+    int single_step;                // stop after the next instruction
+    int resume_over_breakpoint;     // do not stop again at the breakpoint we are continuing from
+    StopReason stop_reason;
+    uint16_t watch_address;         // first watched address written by the last watchpoint stop
+
+    int listen_fd;
+    int client_fd;
+    char packet[DEBUGGER_PACKET_SIZE];
+    int packet_length;
+} Debugger;
+
+int init_debugger(Debugger *debugger, int port);
+int debugger_execute(Debugger *debugger, Chip8 *chip8, int logging);
+void poll_debugger(Debugger *debugger, Chip8 *chip8);
+void close_debugger(Debugger *debugger);
+
+void set_breakpoint(Debugger *debugger, uint16_t address, int enabled);
+void set_watchpoint(Debugger *debugger, uint16_t address, int length, int enabled);
+
+
+#endif // DEBUGGER_H
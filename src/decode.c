@@ -0,0 +1,141 @@
+#include "decode.h"
+
+
+const Instruction INSTRUCTION_TABLE[OPCODE_COUNT] = {
+    [OP_CLS]       = {cls, "Instruction Clear screen (00E0)", "CLS", OPERANDS_NONE, FLOW_NEXT},
+    [OP_RET]       = {return_from_subroutine, "Instruction Return from Subroutine (00EE)", "RET", OPERANDS_NONE, FLOW_RETURN},
+    [OP_JP]        = {jump, "Instruction Jump (1NNN)", "JP 0x%03X", OPERANDS_NNN, FLOW_JUMP},
+    [OP_CALL]      = {call_subroutine, "Instruction Call Subroutine (2NNN)", "CALL 0x%03X", OPERANDS_NNN, FLOW_CALL},
+    [OP_SE_VX_KK]  = {se_Vx_kk, "Skip next instr Vx == kk (3XKK)", "SE V%X, 0x%02X", OPERANDS_X_KK, FLOW_SKIP},
+    [OP_SNE_VX_KK] = {sne_Vx_kk, "Skip next instr Vx != kk (4XKK)", "SNE V%X, 0x%02X", OPERANDS_X_KK, FLOW_SKIP},
+    [OP_SE_VX_VY]  = {se_Vx_Vy, "Skip next instr Vx == Vy (5XY0)", "SE V%X, V%X", OPERANDS_X_Y, FLOW_SKIP},
+    [OP_LD_VX_KK]  = {ld_Vx, "Instruction Load Vx reg (6XKK)", "LD V%X, 0x%02X", OPERANDS_X_KK, FLOW_NEXT},
+    [OP_ADD_VX_KK] = {add_Vx_imm, "Instruction ADD Vx reg immediate (7XKK)", "ADD V%X, 0x%02X", OPERANDS_X_KK, FLOW_NEXT},
+    [OP_LD_VX_VY]  = {move_Vx_Vy, "Instruction Move Vy reg into Vx reg (8XY0)", "LD V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_OR_VX_VY]  = {or_Vx_Vy, "Instruction OR (8XY1)", "OR V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_AND_VX_VY] = {and_Vx_Vy, "Instruction AND (8XY2)", "AND V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_XOR_VX_VY] = {xor_Vx_Vy, "Instruction XOR (8XY3)", "XOR V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_ADD_VX_VY] = {add_Vx_Vy, "Instruction ADD VX VY (8XY4)", "ADD V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_SUB_VX_VY] = {sub_Vx_Vy, "Instruction SUB VX VY (8XY5)", "SUB V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_SHR_VX]    = {shr, "Instruction SHR VX (8XY6)", "SHR V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_SUBN_VX_VY]= {subn_Vx_Vy, "Instruction SUBN VX VY (8XY7)", "SUBN V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_SHL_VX]    = {shl, "Instruction SHL VX (8XYE)", "SHL V%X, V%X", OPERANDS_X_Y, FLOW_NEXT},
+    [OP_SNE_VX_VY] = {sne_Vx_Vy, "Skip next instr Vx != Vy (9XY0)", "SNE V%X, V%X", OPERANDS_X_Y, FLOW_SKIP},
+    [OP_LD_I]      = {ldi, "Instruction LDI (ANNN)", "LD I, 0x%03X", OPERANDS_NNN, FLOW_NEXT},
+    [OP_JP_V0]     = {jump_V0, "Instruction JUMP + V0 (BNNN)", "JP V0, 0x%03X", OPERANDS_NNN, FLOW_INDIRECT},
+    [OP_RND]       = {rnd, "Instruction RNG Vx (CXKK)", "RND V%X, 0x%02X", OPERANDS_X_KK, FLOW_NEXT},
+    [OP_DRW]       = {drw, "Draw Sprite (DXYN)", "DRW V%X, V%X, %u", OPERANDS_X_Y_N, FLOW_NEXT},
+    [OP_SKP]       = {skp, "Instruction Skip next instr if key pressed (009E)", "SKP V%X", OPERANDS_X, FLOW_SKIP},
+    [OP_SKNP]      = {sknp, "Instruction Skip next instr if key not pressed (00A1)", "SKNP V%X", OPERANDS_X, FLOW_SKIP},
+    [OP_LD_VX_DT]  = {ld_Vx_dt, "Instruction Load VX with Delay Timer (0007)", "LD V%X, DT", OPERANDS_X, FLOW_NEXT},
+    [OP_LD_VX_K]   = {ld_Vx_k, "Instruction Wait for key press (000A)", "LD V%X, K", OPERANDS_X, FLOW_WAIT},
+    [OP_LD_DT_VX]  = {ld_dt_Vx, "Instruction Load Delay Timer with VX (0015)", "LD DT, V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_LD_ST_VX]  = {ld_st_Vx, "Instruction Load SOUND Timer with VX (0018)", "LD ST, V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_ADD_I_VX]  = {add_i_Vx, "Instruction ADD Index and Vx (001E)", "ADD I, V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_LD_F_VX]   = {ld_F_Vx, "Instruction LOAD Font from VX value (0029)", "LD F, V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_LD_B_VX]   = {st_bcd_Vx, "Instruction STORE BCD of VX value (0033)", "LD B, V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_ST_V_REGS] = {st_V_regs, "Instruction STORE Regs V[0] - V[X] starting at I register (0055)", "LD [I], V%X", OPERANDS_X, FLOW_NEXT},
+    [OP_LD_V_REGS] = {ld_V_regs, "Instruction LOAD Regs V[0] - V[X] starting at I register (0065)", "LD V%X, [I]", OPERANDS_X, FLOW_NEXT},
+    [OP_INVALID]   = {NULL, "Unrecognized opcode", "DW 0x%04X", OPERANDS_OPCODE, FLOW_INVALID},
+};
+
+
+/*
+* Maps an opcode to the instruction it encodes, following the same
+* nibble layout the interpreter always used. Opcodes that do not
+* encode an instruction are OP_INVALID
+*/
+OpcodeId decode_opcode(uint16_t opcode) {
+    switch(opcode & 0xF000) {
+        case 0x0000:
+            switch(opcode & 0x00FF) {
+                case 0x00E0: return OP_CLS;
+                case 0x00EE: return OP_RET;
+                default: return OP_INVALID;
+            }
+
+        case 0x1000: return OP_JP;
+        case 0x2000: return OP_CALL;
+        case 0x3000: return OP_SE_VX_KK;
+        case 0x4000: return OP_SNE_VX_KK;
+        case 0x5000: return OP_SE_VX_VY;
+        case 0x6000: return OP_LD_VX_KK;
+        case 0x7000: return OP_ADD_VX_KK;
+
+        case 0x8000:
+            switch(opcode & 0x000F) {
+                case 0x0000: return OP_LD_VX_VY;
+                case 0x0001: return OP_OR_VX_VY;
+                case 0x0002: return OP_AND_VX_VY;
+                case 0x0003: return OP_XOR_VX_VY;
+                case 0x0004: return OP_ADD_VX_VY;
+                case 0x0005: return OP_SUB_VX_VY;
+                case 0x0006: return OP_SHR_VX;
+                case 0x0007: return OP_SUBN_VX_VY;
+                case 0x000E: return OP_SHL_VX;
+                default: return OP_INVALID;
+            }
+
+        case 0x9000: return OP_SNE_VX_VY;
+        case 0xA000: return OP_LD_I;
+        case 0xB000: return OP_JP_V0;
+        case 0xC000: return OP_RND;
+        case 0xD000: return OP_DRW;
+
+        case 0xE000:
+            switch(opcode & 0x00FF) {
+                case 0x009E: return OP_SKP;
+                case 0x00A1: return OP_SKNP;
+                default: return OP_INVALID;
+            }
+
+        case 0xF000:
+            switch(opcode & 0x00FF) {
+                case 0x0007: return OP_LD_VX_DT;
+                case 0x000A: return OP_LD_VX_K;
+                case 0x0015: return OP_LD_DT_VX;
+                case 0x0018: return OP_LD_ST_VX;
+                case 0x001E: return OP_ADD_I_VX;
+                case 0x0029: return OP_LD_F_VX;
+                case 0x0033: return OP_LD_B_VX;
+                case 0x0055: return OP_ST_V_REGS;
+                case 0x0065: return OP_LD_V_REGS;
+                default: return OP_INVALID;
+            }
+
+        default:
+            return OP_INVALID;
+    }
+}
+
+
+// Writes the assembly text of an opcode, e.g. "LD V3, 0x1F"
+void format_instruction(uint16_t opcode, char *buffer, size_t size) {
+    const Instruction *instruction = &INSTRUCTION_TABLE[decode_opcode(opcode)];
+    unsigned x = (opcode & 0x0F00) >> 8;
+    unsigned y = (opcode & 0x00F0) >> 4;
+
+    switch (instruction->operands) {
+        case OPERANDS_NONE:
+            snprintf(buffer, size, "%s", instruction->mnemonic);
+            break;
+        case OPERANDS_NNN:
+            snprintf(buffer, size, instruction->mnemonic, opcode & 0x0FFF);
+            break;
+        case OPERANDS_X:
+            snprintf(buffer, size, instruction->mnemonic, x);
+            break;
+        case OPERANDS_X_KK:
+            snprintf(buffer, size, instruction->mnemonic, x, opcode & 0x00FF);
+            break;
+        case OPERANDS_X_Y:
+            snprintf(buffer, size, instruction->mnemonic, x, y);
+            break;
+        case OPERANDS_X_Y_N:
+            snprintf(buffer, size, instruction->mnemonic, x, y, opcode & 0x000F);
+            break;
+        case OPERANDS_OPCODE:
+            snprintf(buffer, size, instruction->mnemonic, opcode);
+            break;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stddef.h>
+#include "instructions.h"
+
+/*
+*
+* Opcode decoding shared by the interpreter and the rom analysis tools.
+*
+* decode_opcode maps a 16 bit opcode to an OpcodeId, and the instruction
+* table holds everything known about that instruction: its handler, the
+* logging text, the assembly mnemonic and how it changes the control flow.
+*
+*/
+
+// instructions are listed in the order of their opcodes
+typedef enum {
+    OP_CLS,             // 00E0
+    OP_RET,             // 00EE
+    OP_JP,              // 1NNN
+    OP_CALL,            // 2NNN
+    OP_SE_VX_KK,        // 3XKK
+    OP_SNE_VX_KK,       // 4XKK
+    OP_SE_VX_VY,        // 5XY0
+    OP_LD_VX_KK,        // 6XKK
+    OP_ADD_VX_KK,       // 7XKK
+    OP_LD_VX_VY,        // 8XY0
+    OP_OR_VX_VY,        // 8XY1
+    OP_AND_VX_VY,       // 8XY2
+    OP_XOR_VX_VY,       // 8XY3
+    OP_ADD_VX_VY,       // 8XY4
+    OP_SUB_VX_VY,       // 8XY5
+    OP_SHR_VX,          // 8XY6
+    OP_SUBN_VX_VY,      // 8XY7
+    OP_SHL_VX,          // 8XYE
+    OP_SNE_VX_VY,       // 9XY0
+    OP_LD_I,            // ANNN
+    OP_JP_V0,           // BNNN
+    OP_RND,             // CXKK
+    OP_DRW,             // DXYN
+    OP_SKP,             // EX9E
+    OP_SKNP,            // EXA1
+    OP_LD_VX_DT,        // FX07
+    OP_LD_VX_K,         // FX0A
+    OP_LD_DT_VX,        // FX15
+    OP_LD_ST_VX,        // FX18
+    OP_ADD_I_VX,        // FX1E
+    OP_LD_F_VX,         // FX29
+    OP_LD_B_VX,         // FX33
+    OP_ST_V_REGS,       // FX55
+    OP_LD_V_REGS,       // FX65
+    OP_INVALID,         // anything else
+    OPCODE_COUNT
+} OpcodeId;
+
+// How an instruction affects the pc_reg
+typedef enum {
+    FLOW_NEXT,          // continues with the next instruction
+    FLOW_JUMP,          // jumps to NNN
+    FLOW_CALL,          // calls NNN, execution resumes after it on return
+    FLOW_RETURN,        // returns to the address on the stack
+    FLOW_SKIP,          // continues with the next or the one after that
+    FLOW_INDIRECT,      // jumps to an address only known at runtime (BNNN)
+    FLOW_WAIT,          // repeats itself until a key is pressed (FX0A)
+    FLOW_INVALID        // unrecognized opcode, execution stops
+} InstructionFlow;
+
+// Operand layout, used to format the mnemonic
+typedef enum {
+    OPERANDS_NONE,
+    OPERANDS_NNN,
+    OPERANDS_X,
+    OPERANDS_X_KK,
+    OPERANDS_X_Y,
+    OPERANDS_X_Y_N,
+    OPERANDS_OPCODE
+} InstructionOperands;
+
+typedef struct {
+    void (*handler)(Chip8 *chip8);
+    const char *log_text;               // printed by execute_instruction when logging
+    const char *mnemonic;               // printf format for the assembly text
+    InstructionOperands operands;
+    InstructionFlow flow;
+} Instruction;
+
+extern const Instruction INSTRUCTION_TABLE[OPCODE_COUNT];
+
+OpcodeId decode_opcode(uint16_t opcode);
+void format_instruction(uint16_t opcode, char *buffer, size_t size);
+
+
+#endif // DECODE_H
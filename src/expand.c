@@ -0,0 +1,154 @@
+#include <string.h>
+#include "expand.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXPAND_X86 1
+#include <immintrin.h>
+#endif
+
+
+/*
+* Scalar kernel, also used for the tail of the vector kernels.
+* Screen pixels are always 0 or 1, so every destination pixel is
+* background ^ ((foreground ^ background) & -pixel) with no branch per pixel.
+*
+* The pixels go in blocks of a fixed 16 so that -O2, which only vectorizes
+* loops that need no remainder, still vectorizes the kernel like it did the
+* fixed width loop it replaced. restrict tells it the rows do not overlap
+*/
+static void expand_row_scalar(const uint8_t *restrict pixels, uint32_t *restrict dest, int count, Palette palette) {
+    uint32_t diff = palette.foreground ^ palette.background;
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        for (int j = 0; j < 16; j++) {
+            dest[i + j] = palette.background ^ (diff & -(uint32_t)pixels[i + j]);
+        }
+    }
+    for (; i < count; i++) {
+        dest[i] = palette.background ^ (diff & -(uint32_t)pixels[i]);
+    }
+}
+
+
+#ifdef EXPAND_X86
+
+// SSE2 kernel: 16 pixels per iteration, the byte mask is widened to 32 bits with unpacks
+__attribute__((target("sse2")))
+static void expand_row_sse2(const uint8_t *pixels, uint32_t *dest, int count, Palette palette) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i fg = _mm_set1_epi32((int)palette.foreground);
+    const __m128i diff = _mm_set1_epi32((int)(palette.foreground ^ palette.background));
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        // off_mask bytes are 0xFF where the pixel is off
+        __m128i off_mask = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pixels + i)), zero);
+        __m128i lo = _mm_unpacklo_epi8(off_mask, off_mask);
+        __m128i hi = _mm_unpackhi_epi8(off_mask, off_mask);
+
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_xor_si128(fg, _mm_and_si128(diff, _mm_unpacklo_epi16(lo, lo))));
+        _mm_storeu_si128((__m128i *)(dest + i + 4), _mm_xor_si128(fg, _mm_and_si128(diff, _mm_unpackhi_epi16(lo, lo))));
+        _mm_storeu_si128((__m128i *)(dest + i + 8), _mm_xor_si128(fg, _mm_and_si128(diff, _mm_unpacklo_epi16(hi, hi))));
+        _mm_storeu_si128((__m128i *)(dest + i + 12), _mm_xor_si128(fg, _mm_and_si128(diff, _mm_unpackhi_epi16(hi, hi))));
+    }
+
+    expand_row_scalar(pixels + i, dest + i, count - i, palette);
+}
+
+
+// AVX2 kernel: 8 pixels per store, the byte mask is sign extended straight to 32 bits
+__attribute__((target("avx2")))
+static void expand_row_avx2(const uint8_t *pixels, uint32_t *dest, int count, Palette palette) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m256i fg = _mm256_set1_epi32((int)palette.foreground);
+    const __m256i diff = _mm256_set1_epi32((int)(palette.foreground ^ palette.background));
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i off_mask = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pixels + i)), zero);
+        __m256i lo = _mm256_cvtepi8_epi32(off_mask);
+        __m256i hi = _mm256_cvtepi8_epi32(_mm_srli_si128(off_mask, 8));
+
+        _mm256_storeu_si256((__m256i *)(dest + i), _mm256_xor_si256(fg, _mm256_and_si256(diff, lo)));
+        _mm256_storeu_si256((__m256i *)(dest + i + 8), _mm256_xor_si256(fg, _mm256_and_si256(diff, hi)));
+    }
+
+    expand_row_scalar(pixels + i, dest + i, count - i, palette);
+}
+
+#endif // EXPAND_X86
+
+
+static const char *selected_kernel_name = "scalar";
+
+// Picks the widest kernel supported by the cpu the first time it is called
+static void expand_row_resolve(const uint8_t *pixels, uint32_t *dest, int count, Palette palette);
+static ExpandRowFunc selected_kernel = expand_row_resolve;
+
+static void expand_row_resolve(const uint8_t *pixels, uint32_t *dest, int count, Palette palette) {
+    ExpandRowFunc kernel = expand_kernel("avx2");
+    selected_kernel_name = "avx2";
+
+    if (kernel == NULL) {
+        kernel = expand_kernel("sse2");
+        selected_kernel_name = "sse2";
+    }
+    if (kernel == NULL) {
+        kernel = expand_kernel("scalar");
+        selected_kernel_name = "scalar";
+    }
+
+    selected_kernel = kernel;
+    kernel(pixels, dest, count, palette);
+}
+
+
+ExpandRowFunc expand_kernel(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        return expand_row_scalar;
+    }
+#ifdef EXPAND_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return expand_row_sse2;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return expand_row_avx2;
+    }
+#endif
+    return NULL;
+}
+
+
+const char *expand_kernel_name(void) {
+    if (selected_kernel == expand_row_resolve) {
+        uint8_t pixel = 0;
+        uint32_t colour;
+        Palette palette = {DEFAULT_FOREGROUND, DEFAULT_BACKGROUND};
+        expand_row_resolve(&pixel, &colour, 1, palette);
+    }
+    return selected_kernel_name;
+}
+
+
+void expand_row(const uint8_t *pixels, uint32_t *dest, int count, Palette palette) {
+    selected_kernel(pixels, dest, count, palette);
+}
+
+
+/*
+* Expands the whole chip8 screen into dest. dest_pitch is the distance
+* between destination rows in pixels, so rows can be written directly
+* into memory that is wider than the screen
+*/
+void expand_screen(Chip8 *chip8, uint32_t *dest, int dest_pitch, Palette palette) {
+    if (dest_pitch == SCREEN_WIDTH) {
+        selected_kernel(&chip8->screen[0][0], dest, SCREEN_WIDTH * SCREEN_HEIGHT, palette);
+        return;
+    }
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        selected_kernel(chip8->screen[y], dest + (y * dest_pitch), SCREEN_WIDTH, palette);
+    }
+}
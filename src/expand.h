@@ -0,0 +1,35 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stdint.h>
+#include "chip8_t.h"
+
+/*
+*
+* Conversion of the 1 pixel per byte chip8 screen into RGBA8888 pixels.
+*
+* A SSE2 or AVX2 kernel is picked the first time a row is expanded, based
+* on what the host cpu supports, with a portable scalar kernel as fallback.
+*
+*/
+
+#define DEFAULT_FOREGROUND 0xFFFFFFFF   // white
+#define DEFAULT_BACKGROUND 0x000000FF   // black
+
+typedef struct {
+    uint32_t foreground;    // colour of pixels that are on
+    uint32_t background;    // colour of pixels that are off
+} Palette;
+
+typedef void (*ExpandRowFunc)(const uint8_t *pixels, uint32_t *dest, int count, Palette palette);
+
+void expand_screen(Chip8 *chip8, uint32_t *dest, int dest_pitch, Palette palette);
+void expand_row(const uint8_t *pixels, uint32_t *dest, int count, Palette palette);
+const char *expand_kernel_name(void);
+
+// Individual kernels, exposed for benchmarking. A NULL return
+// means the kernel is not supported by the host cpu
+ExpandRowFunc expand_kernel(const char *name);
+
+
+#endif // EXPAND_H
@@ -0,0 +1,67 @@
+#include "input.h"
+#include "latency.h"
+
+
+/* 
+* Gets user input and updates the keyboard key status based on what keys 
+* were or were not pressed.
+*
+* Also checks for key presses that have other functionality in the emulator
+*   ESC: Exit Emulator
+*   Spacebar: Pause Emulator
+*   F5: Reset Emulator
+*/
+void process_user_input(Chip8 *chip8) {
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+
+        // Check for keys that were pressed
+        if (e.type == SDL_KEYDOWN) {
+
+            switch (e.key.keysym.sym) {
+                case SDLK_ESCAPE:
+                    chip8->is_running_flag = FALSE;
+                    break;
+
+                case SDLK_SPACE:
+                    if (chip8->is_paused_flag) {
+                        chip8->is_paused_flag = FALSE;
+                    }
+                    else {
+                        chip8->is_paused_flag = TRUE;
+                    }
+                    break;
+
+                case SDLK_F5:
+                    reset_system(chip8);
+                    break;
+
+                default:
+                    break;
+                }
+
+            // sets the bit of each key in the keyboard mask that was pressed
+            for (int i = 0; i < NUM_KEYS; i++) {
+                if (e.key.keysym.sym == KEYMAP[i]) {
+                    chip8->keyboard |= 1 << i;
+                    if (!e.key.repeat) {latency_key_event();}
+                }
+            }
+         }
+
+         // checks for keys that were released, clears their bit in the keyboard mask
+         if (e.type == SDL_KEYUP) {
+             for (int i = 0; i < NUM_KEYS; i++) {
+                if (e.key.keysym.sym == KEYMAP[i]) {
+                    chip8->keyboard &= ~(1 << i);
+                    latency_key_event();
+                }
+            }
+         }
+
+         // Checks for the 'x' button on the window to be pressed
+         if (e.type == SDL_QUIT) {
+            chip8->is_running_flag = FALSE;
+         } 
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SDL2/SDL.h>
+#include "chip8.h"
+
+
+// Keymap for the emulator. Comments are the orignal
+// key on the hex keypad
+const static uint8_t KEYMAP[NUM_KEYS] = {
+    SDLK_x, // 0
+    SDLK_1, // 1
+    SDLK_2, // 2
+    SDLK_3, // 3
+    SDLK_q, // 4
+    SDLK_w, // 5
+    SDLK_e, // 6
+    SDLK_a, // 7
+    SDLK_s, // 8
+    SDLK_d, // 9
+    SDLK_z, // A
+    SDLK_c, // B
+    SDLK_4, // C
+    SDLK_r, // D
+    SDLK_f, // E
+    SDLK_v  // F
+};
+
+
+void process_user_input(Chip8 *chip8);
+
+
+#endif // INPUT_H
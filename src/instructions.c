@@ -1,4 +1,5 @@
 #include "instructions.h"
+#include "quirks.h"
 
 /*
 * Opcode 00E0: Clear the display
@@ -10,6 +11,7 @@ void cls(Chip8 *chip8) {
             chip8->screen[i][j] = 0;
         }
     }
+    chip8->screen_hash = 0;
     chip8->draw_screen_flag = TRUE;
     chip8->pc_reg += 2;
 }
@@ -18,8 +20,15 @@ void cls(Chip8 *chip8) {
 /*
 * Opcode 00EE: Return from subroutine
 * pc_reg popped from top of stack, sp_reg decremented
+* Stops the system with CHIP8_ERROR_STACK_UNDERFLOW if the stack is empty
 */
 void return_from_subroutine(Chip8 *chip8) {
+    if (chip8->sp_reg == 0) {
+        chip8->error = CHIP8_ERROR_STACK_UNDERFLOW;
+        chip8->is_running_flag = FALSE;
+        return;
+    }
+
     chip8->sp_reg--;
     chip8->pc_reg = chip8->stack[chip8->sp_reg];
     chip8->pc_reg += 2;
@@ -40,10 +49,17 @@ void jump(Chip8 *chip8) {
 /*
 * Opcode 2NNN: Call Subroutine at NNN
 * sp_reg incremented, pc_reg pushed to stack, pc_reg set to NNN
+* Stops the system with CHIP8_ERROR_STACK_OVERFLOW if the stack is full
 */
 void call_subroutine(Chip8 *chip8) {
     uint16_t nnn = chip8->current_op & 0x0FFF;
 
+    if (chip8->sp_reg >= STACK_SIZE) {
+        chip8->error = CHIP8_ERROR_STACK_OVERFLOW;
+        chip8->is_running_flag = FALSE;
+        return;
+    }
+
     chip8->stack[chip8->sp_reg] = chip8->pc_reg;
     chip8->sp_reg++;
     chip8->pc_reg = nnn;
@@ -144,39 +160,30 @@ void move_Vx_Vy(Chip8 *chip8) {
 /*
 * Opcode 8XY1: OR Vx, Vy
 * V[X] | V[Y] result stored in V[X]
+* Depends on the quirk profile, see quirks.h
 */
 void or_Vx_Vy(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
-
-    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] | chip8->V[target_v_reg_y]);
-    chip8->pc_reg += 2;
+    or_Vx_Vy_quirks(chip8, chip8->quirks);
 }
 
 
 /*
 * Opcode 8XY2: AND Vx, Vy
 * V[X] & V[Y] result stored in V[X]
+* Depends on the quirk profile, see quirks.h
 */
 void and_Vx_Vy(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
-
-    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] & chip8->V[target_v_reg_y]);
-    chip8->pc_reg += 2;
+    and_Vx_Vy_quirks(chip8, chip8->quirks);
 }
 
 
 /*
 * Opcode 8XY3: XOR Vx, Vy
 * V[X] ^ V[Y] result stored in V[X]
+* Depends on the quirk profile, see quirks.h
 */
 void xor_Vx_Vy(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
-
-    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] ^ chip8->V[target_v_reg_y]);
-    chip8->pc_reg += 2;
+    xor_Vx_Vy_quirks(chip8, chip8->quirks);
 }
 
 
@@ -227,21 +234,10 @@ void sub_Vx_Vy(Chip8 *chip8) {
 /*
 * Opcode 8XY6: SHR Vx
 * V[X] = V[X] >> 1
-* If LSb of V[X] == 1, V[F] register is set to 1, else 0
+* Depends on the quirk profile, see quirks.h
 */
 void shr(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-
-    // check if the LSb is 1 (odd num in V[X] will have a LSB of 1) 
-    if (chip8->V[target_v_reg_x] % 2 == 1) {
-        chip8->V[0xF] = 1;
-    }
-    else {
-        chip8->V[0xF] = 0;
-    }
-
-    chip8->V[target_v_reg_x] = chip8->V[target_v_reg_x] >> 1;
-    chip8->pc_reg += 2;
+    shr_quirks(chip8, chip8->quirks);
 }
 
 
@@ -267,23 +263,12 @@ void subn_Vx_Vy(Chip8 *chip8) {
 
 
 /*
-* Opcode 8XY6: SHL Vx
+* Opcode 8XYE: SHL Vx
 * V[X] = V[X] << 1
-* If MSb of V[X] == 1, V[F] register is set to 1, else 0
+* Depends on the quirk profile, see quirks.h
 */
 void shl(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-
-    // check if the MSb is 1
-    if ((chip8->V[target_v_reg_x] & 10000000) == 1) {
-        chip8->V[0xF] = 1;
-    }
-    else {
-        chip8->V[0xF] = 0;
-    }
-
-    chip8->V[target_v_reg_x] = chip8->V[target_v_reg_x] << 1;
-    chip8->pc_reg += 2;
+    shl_quirks(chip8, chip8->quirks);
 }
 
 
@@ -319,11 +304,10 @@ void ldi(Chip8 *chip8) {
 /*
 * Opcode BNNN: Jump + V[0]
 * set pc_register to NNN + V[0]
+* Depends on the quirk profile, see quirks.h
 */
 void jump_V0(Chip8 *chip8) {
-    uint16_t nnn = chip8->current_op & 0x0FFF;
-
-    chip8->pc_reg = (nnn + chip8->V[0]);
+    jump_V0_quirks(chip8, chip8->quirks);
 }
 
 
@@ -331,11 +315,19 @@ void jump_V0(Chip8 *chip8) {
 * Opcode CXKK: Random
 * Generate Random Num between 0 - 255 then bitwise AND with value KK.
 * Store the result in V[X]
+* The number comes from the xorshift32 generator in rng_state, so two
+* systems seeded the same way draw the same numbers
 */
 void rnd(Chip8 *chip8) {
     uint8_t target_v_reg = (chip8->current_op & 0x0F00) >> 8;
     uint8_t kk = chip8->current_op & 0x00FF;
-    uint8_t random_num = rand() % 256;
+
+    uint32_t state = chip8->rng_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    chip8->rng_state = state;
+    uint8_t random_num = state >> 24;
 
     chip8->V[target_v_reg] = random_num & kk;
     chip8->pc_reg += 2;
@@ -345,34 +337,10 @@ void rnd(Chip8 *chip8) {
 /*
 * Opcode DXYN: Display N-byte sprite at ram[I_reg]
 * Draws sprite at location V[X], V[Y]. Set V[F] if collision
-*
-* Initial source of implimentation used as template found below:
-* http://www.multigesture.net/articles/how-to-write-an-emulator-chip-8-interpreter/
+* Depends on the quirk profile, see quirks.h
 */
 void drw(Chip8 *chip8) {
-    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
-    uint8_t sprite_height = chip8->current_op & 0x000F;
-    uint8_t x_location = chip8->V[target_v_reg_x];
-    uint8_t y_location = chip8->V[target_v_reg_y];
-    uint8_t pixel;
-
-    // Reset collision register to FALSE
-    chip8->V[0xF] = FALSE;
-    for (int y_coordinate = 0; y_coordinate < sprite_height; y_coordinate++) {
-        pixel = chip8->ram[chip8->I_reg + y_coordinate];
-        for (int x_coordinate = 0; x_coordinate < 8; x_coordinate++) {
-            if ((pixel & (0x80 >> x_coordinate)) != 0) {
-                if (chip8->screen[y_location + y_coordinate][x_location + x_coordinate] == 1) {
-                    chip8->V[0xF] = TRUE;
-                }
-                chip8->screen[y_location + y_coordinate][x_location + x_coordinate] ^= 1;
-            }
-        }
-    }
-
-    chip8->draw_screen_flag = TRUE;
-    chip8->pc_reg += 2;
+    drw_quirks(chip8, chip8->quirks);
 }
 
 
@@ -382,9 +350,10 @@ void drw(Chip8 *chip8) {
 */
 void skp(Chip8 *chip8) {
     uint8_t target_v_reg = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t vX_value = chip8->V[target_v_reg];
+    uint8_t vX_value = chip8->V[target_v_reg] & 0xF;
 
-    if (chip8->keyboard[vX_value] != FALSE) {
+    chip8->key_read_flag = TRUE;
+    if (chip8->keyboard & (1 << vX_value)) {
         chip8->pc_reg += 4;
     }
     else {
@@ -399,9 +368,10 @@ void skp(Chip8 *chip8) {
 */
 void sknp(Chip8 *chip8) {
     uint8_t target_v_reg = (chip8->current_op & 0x0F00) >> 8;
-    uint8_t vX_value = chip8->V[target_v_reg];
+    uint8_t vX_value = chip8->V[target_v_reg] & 0xF;
 
-    if (chip8->keyboard[vX_value] == FALSE) {
+    chip8->key_read_flag = TRUE;
+    if (!(chip8->keyboard & (1 << vX_value))) {
         chip8->pc_reg += 4;
     }
     else {
@@ -431,9 +401,10 @@ void ld_Vx_k(Chip8 *chip8) {
     uint8_t target_v_reg = (chip8->current_op & 0x0F00) >> 8;
 
     chip8->was_key_pressed = FALSE;
+    chip8->key_read_flag = TRUE;
 
     for (int i = 0; i < NUM_KEYS; i++) {
-        if (chip8->keyboard[i] != FALSE) {
+        if (chip8->keyboard & (1 << i)) {
             chip8->V[target_v_reg] = i;
             chip8->was_key_pressed = TRUE;
         }
@@ -506,9 +477,9 @@ void ld_F_Vx(Chip8 *chip8) {
 void st_bcd_Vx(Chip8 *chip8) {
     uint8_t target_v_reg = (chip8->current_op & 0x0F00) >> 8;
 
-    chip8->ram[chip8->I_reg] = chip8->V[target_v_reg] / 100;                 // MSb
-    chip8->ram[chip8->I_reg + 1] = (chip8->V[target_v_reg] / 10) % 10;
-    chip8->ram[chip8->I_reg + 2] = (chip8->V[target_v_reg] % 100) % 10;      // LSb
+    write_ram(chip8, chip8->I_reg, chip8->V[target_v_reg] / 100);                 // MSb
+    write_ram(chip8, chip8->I_reg + 1, (chip8->V[target_v_reg] / 10) % 10);
+    write_ram(chip8, chip8->I_reg + 2, (chip8->V[target_v_reg] % 100) % 10);      // LSb
     chip8->pc_reg += 2;
 }
 
@@ -516,34 +487,18 @@ void st_bcd_Vx(Chip8 *chip8) {
 /*
 * Opcode FX55: LD [I], Vx
 * Store V[0] - V[X] in memory starting at I_reg value
+* Depends on the quirk profile, see quirks.h
 */
 void st_V_regs(Chip8 *chip8) {
-    uint8_t end_ld_v_reg = (chip8->current_op & 0x0F00) >> 8;
-
-    for (int i = 0; i <= end_ld_v_reg; i++) {
-        chip8->ram[chip8->I_reg + i] = chip8->V[i];
-    }
-
-    // TODO: Does I_reg need to change?
-    chip8->I_reg += (end_ld_v_reg + 1);
-
-    chip8->pc_reg += 2;
+    st_V_regs_quirks(chip8, chip8->quirks);
 }
 
 
 /*
 * Opcode FX65: LD Vx, I
 * Read values into V[0] - V[X] from memory starting at I_reg value
+* Depends on the quirk profile, see quirks.h
 */
 void ld_V_regs(Chip8 *chip8) {
-    uint8_t end_ld_v_reg = (chip8->current_op & 0x0F00) >> 8;
-
-    for (int i = 0; i <= end_ld_v_reg; i++) {
-        chip8->V[i] = chip8->ram[chip8->I_reg + i];
-    }
-
-    // TODO: Does I_reg need to change?
-    chip8->I_reg += (end_ld_v_reg + 1);
-
-    chip8->pc_reg += 2;
+    ld_V_regs_quirks(chip8, chip8->quirks);
 }
@@ -0,0 +1,123 @@
+#include "latency.h"
+#include "chip8_t.h"
+
+
+static int latency_enabled = FALSE;
+static int overlay_enabled = FALSE;
+static Uint32 last_overlay_update = 0;
+
+// Key events that have not been presented yet, the first consumed_count
+// of them have been read by the rom and complete on the next present
+static Uint64 pending_events[LATENCY_MAX_PENDING];
+static int pending_count = 0;
+static int consumed_count = 0;
+
+// Ring buffer of latency samples in performance counter ticks
+static Uint64 samples[LATENCY_MAX_SAMPLES];
+static int sample_count = 0;
+static int next_sample = 0;
+
+
+void init_latency(int live_overlay) {
+    latency_enabled = TRUE;
+    overlay_enabled = live_overlay;
+    pending_count = 0;
+    consumed_count = 0;
+    sample_count = 0;
+    next_sample = 0;
+}
+
+
+// Timestamps a key press or release of a mapped chip8 key
+void latency_key_event(void) {
+    if (!latency_enabled || pending_count == LATENCY_MAX_PENDING) {
+        return;
+    }
+    pending_events[pending_count++] = SDL_GetPerformanceCounter();
+}
+
+
+// Called after an instruction read the keyboard, every event so far is now visible to the rom
+void latency_key_consumed(void) {
+    consumed_count = pending_count;
+}
+
+
+static int compare_samples(const void *a, const void *b) {
+    Uint64 first = *(const Uint64 *) a;
+    Uint64 second = *(const Uint64 *) b;
+    return (first > second) - (first < second);
+}
+
+
+// Returns the p50 and p99 latency in milliseconds, FALSE if there are no samples yet
+static int latency_percentiles(double *p50, double *p99, double *max) {
+    static Uint64 sorted[LATENCY_MAX_SAMPLES];
+    double ticks_per_ms = SDL_GetPerformanceFrequency() / 1000.0;
+
+    if (sample_count == 0) {
+        return FALSE;
+    }
+
+    memcpy(sorted, samples, sample_count * sizeof(Uint64));
+    qsort(sorted, sample_count, sizeof(Uint64), compare_samples);
+
+    *p50 = sorted[(sample_count - 1) * 50 / 100] / ticks_per_ms;
+    *p99 = sorted[(sample_count - 1) * 99 / 100] / ticks_per_ms;
+    *max = sorted[sample_count - 1] / ticks_per_ms;
+    return TRUE;
+}
+
+
+/*
+* Called right after SDL_RenderPresent. Every consumed key event gets a
+* latency sample, and the window title is refreshed if the overlay is on
+*/
+void latency_frame_presented(SDL_Window *window) {
+    if (!latency_enabled) {
+        return;
+    }
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    for (int i = 0; i < consumed_count; i++) {
+        samples[next_sample] = now - pending_events[i];
+        next_sample = (next_sample + 1) % LATENCY_MAX_SAMPLES;
+        if (sample_count < LATENCY_MAX_SAMPLES) {
+            sample_count++;
+        }
+    }
+
+    // Shift the unconsumed events to the front
+    memmove(pending_events, pending_events + consumed_count, (pending_count - consumed_count) * sizeof(Uint64));
+    pending_count -= consumed_count;
+    consumed_count = 0;
+
+    if (overlay_enabled && SDL_GetTicks() - last_overlay_update >= LATENCY_OVERLAY_INTERVAL) {
+        char title[128];
+        double p50, p99, max;
+
+        if (latency_percentiles(&p50, &p99, &max)) {
+            snprintf(title, sizeof(title), "CHIP-8  input latency p50 %.1f ms  p99 %.1f ms", p50, p99);
+            SDL_SetWindowTitle(window, title);
+        }
+        last_overlay_update = SDL_GetTicks();
+    }
+}
+
+
+void print_latency_report(void) {
+    double p50, p99, max;
+
+    if (!latency_enabled) {
+        return;
+    }
+    if (!latency_percentiles(&p50, &p99, &max)) {
+        printf("Input latency: no key presses were read by the rom\n");
+        return;
+    }
+
+    printf("Input latency samples: %i\n", sample_count);
+    printf("Input latency p50: %.2f ms\n", p50);
+    printf("Input latency p99: %.2f ms\n", p99);
+    printf("Input latency max: %.2f ms\n", max);
+}
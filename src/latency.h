@@ -0,0 +1,26 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <SDL2/SDL.h>
+
+/*
+*
+* Input to photon latency measurement.
+*
+* A key event is timestamped when it is polled, marked consumed once the
+* rom reads the keyboard (skp, sknp, ld_Vx_k), and the latency sample is
+* taken when the next frame is presented after that.
+*
+*/
+
+#define LATENCY_MAX_SAMPLES 4096        // most recent samples kept for the percentiles
+#define LATENCY_MAX_PENDING 32          // key events waiting to be consumed or presented
+#define LATENCY_OVERLAY_INTERVAL 1000   // ms between live overlay updates
+
+void init_latency(int live_overlay);
+void latency_key_event(void);
+void latency_key_consumed(void);
+void latency_frame_presented(SDL_Window *window);
+void print_latency_report(void);
+
+#endif // LATENCY_H
@@ -7,76 +7,529 @@
 * Example startup input: <unix> ./chip8 rom_dir/rom_name
 * 
 * To enable command line logging: <unix> ./chip8 rom_dir/rom_name log
+*
+* Options can be combined after the rom name:
+*   log             print every instruction and the registers
+*   time            print cycle timing when the emulator exits
+*   fg=RRGGBB       colour of pixels that are on
+*   bg=RRGGBB       colour of pixels that are off
+*   timing=NAME     cycle costs: fixed (default, 9 instructions a frame) or vip
+*   cycles=N        cycles to spend in every 60 Hz frame instead of the profile's budget
+*   vblank          DXYN waits for the next frame like on the VIP (on with timing=vip)
+*   quirks=NAME     quirk profile the rom expects: legacy (default), vip, schip or xochip
+*   wrap            sprites wrap around the screen edges instead of being clipped
+*   vsync           present in step with the display refresh
+*   latest          while the emulator catches up after a stall, only present the frame it catches up on
+*   runahead=N      show the screen N frames ahead of the emulation to hide the rom's input lag
+*   mute            do not open an audio device for the buzzer
+*   latency         report input to photon latency percentiles on exit
+*   latency=live    also show the latency percentiles in the window title
+*   shm=/name       publish the screen and registers every frame in shared memory
+*   record=FILE     record the presented screens to FILE (.c8v, see tools/chip8_video.c)
+*   wall=N          run N instances of the rom with different seeds, tiled in one window
+*   gdb=PORT        start stopped and wait for gdb on localhost:PORT
+*   seed=N          seed of the random number generator (CXKK), the time by default (fixed with netplay)
+*   netplay=LOCAL:HOST:PORT  play with the emulator at HOST:PORT (IPv4), receiving on port LOCAL
+*   netdelay=MS     netplay testing: hold every packet sent back by MS milliseconds
+*   netloss=PERCENT netplay testing: drop this share of the packets sent
 */
 
 #include <string.h>
 #include "chip8.h"
+#include "quirks.h"
+#include "api.h"
+#include "input.h"
 #include "screen.h"
+#include "audio.h"
+#include "latency.h"
+#include "shared_frame.h"
+#include "debugger.h"
+#include "timing.h"
+#include "netplay.h"
+#include "recorder.h"
+
+#ifdef CHIP8_AOT
+#include "aot.h"
+#endif
 
-#include <unistd.h>
 #include <time.h>
 
-#define CPU_CLOCK_DELAY 1000            // 1 millisecond
-#define TIMER_CLOCK_DIVISION 9
+#define RUN_AHEAD_MAX 8
+#define WALL_MAX 256
+
+
+// Parses a RRGGBB hex colour into a RGBA8888 pixel, returns FALSE if it is malformed
+static int parse_colour(const char *text, uint32_t *colour) {
+    char *end;
+    unsigned long rgb = strtoul(text, &end, 16);
+
+    if (end == text || *end != '\0' || rgb > 0xFFFFFF) {
+        return FALSE;
+    }
+    *colour = ((uint32_t)rgb << 8) | 0xFF;
+    return TRUE;
+}
+
+
+/*
+* Charges the instructions that just ran against the frame budget, ops
+* holds their OpcodeIds as recorded by the execute path (current_op_id, or
+* the ops of a translated block), and counts the ones that changed the
+* screen (DXYN and 00E0) in screen_updates. Returns TRUE if one of them
+* was a DXYN
+*/
+static int spend_cycles(const TimingProfile *timing, const uint8_t *ops, int executed,
+                        int32_t *budget, uint32_t *screen_updates) {
+    int drew = FALSE;
+
+    for (int i = 0; i < executed; i++) {
+        OpcodeId id = ops[i];
+
+        *budget -= timing->costs[id];
+        drew |= id == OP_DRW;
+        *screen_updates += id == OP_DRW || id == OP_CLS;
+    }
+    return drew;
+}
+
+
+/*
+* Bookkeeping after instructions of the played system ran (ops as for
+* spend_cycles): their cycles are charged (a DXYN ends the frame when the
+* timing waits for the display), the buzzer follows the sound timer, key
+* reads are reported to the latency meter and the registers are printed
+* when logging
+*/
+static inline void finish_instructions(Chip8 *chip8, const TimingProfile *timing, const uint8_t *ops, int executed,
+                                       int32_t *budget, uint32_t *screen_updates, int *buzzer_on, int logging) {
+    // A DXYN waits for the vblank, nothing else runs in this frame
+    int drew = spend_cycles(timing, ops, executed, budget, screen_updates);
+    if (drew && timing->display_wait && *budget > 0) {
+        *budget = 0;
+    }
+
+    // Start the buzzer as soon as a FX18 sets the sound timer
+    if ((chip8->sound_timer > 0) != *buzzer_on) {
+        *buzzer_on = !*buzzer_on;
+        set_buzzer(*buzzer_on);
+    }
+
+    // A skp, sknp or ld_Vx_k read the keyboard, pending key events count as consumed
+    if (chip8->key_read_flag) {
+        latency_key_consumed();
+        chip8->key_read_flag = FALSE;
+    }
+
+    // DEBUG: Register printout if logging
+    if (logging) {print_regs(chip8);}
+}
+
+
+/*
+* Runs one frame of a system that is not the one the user plays (a run ahead
+* copy or a wall instance): the budget is spent like in the main loop (without
+* the debugger, logging or translated blocks), then the timers are updated
+*/
+static void run_side_frame(Chip8 *chip8, const TimingProfile *timing, int32_t *budget) {
+    uint32_t screen_updates = 0;
+
+    *budget += timing->frame_cycles;
+    while (*budget > 0 && chip8->is_running_flag) {
+        execute_instruction(chip8, FALSE);
+
+        int drew = spend_cycles(timing, &chip8->current_op_id, 1, budget, &screen_updates);
+        if (drew && timing->display_wait && *budget > 0) {
+            *budget = 0;
+        }
+    }
+    update_timers(chip8);
+}
+
+
+/*
+* Runs count instances of the rom tiled in one window, each drawing its own
+* random numbers (seed + instance). The keys held go to every instance, an
+* instance that stops with an error stays on screen as it stopped. There is
+* no sound. Runs until the window is closed
+*/
+static void run_wall(const char *rom_filename, int count, uint8_t quirks, const TimingProfile *timing,
+                     uint32_t seed, int vsync, Palette palette) {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    TileAtlas atlas;
+
+    Chip8 *systems = malloc(sizeof(Chip8) * count);
+    int32_t *budgets = calloc(count, sizeof(int32_t));
+    if (systems == NULL || budgets == NULL) {
+        printf("ERROR: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Keys, pause and exit are read into a system that is never run
+    Chip8 controls;
+    init_system(&controls);
+
+    SDL_Init(SDL_INIT_EVERYTHING);
+    init_window(&window, &renderer, &texture, vsync);
+    set_palette(palette);
+    if (!init_tile_atlas(renderer, &atlas, count)) {exit(EXIT_FAILURE);}
+
+    init_system(&systems[0]);
+    load_rom(&systems[0], rom_filename);
+    systems[0].quirks = quirks;
+    for (int i = 0; i < count; i++) {
+        systems[i] = systems[0];
+        seed_random(&systems[i], seed + i);
+    }
+
+    const Uint64 ticks_per_frame = SDL_GetPerformanceFrequency() / FRAMES_PER_SECOND;
+    Uint64 next_frame = SDL_GetPerformanceCounter() + ticks_per_frame;
+    uint32_t frames = 0;
+    uint64_t tiles_updated = 0;
+    uint32_t presents = 0;
+
+    while (controls.is_running_flag) {
+        for (int i = 0; i < count; i++) {
+            if (!systems[i].is_running_flag) {continue;}
+            chip8_set_keys(&systems[i], controls.keyboard);
+            run_side_frame(&systems[i], timing, &budgets[i]);
+        }
+
+        int updated = draw_tiles(systems, count, renderer, &atlas);
+        tiles_updated += updated;
+        presents += updated > 0;
+        frames++;
+
+        do {
+            process_user_input(&controls);
+        } while (controls.is_paused_flag && controls.is_running_flag);
+
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next_frame) {
+            SDL_Delay((Uint32)((next_frame - now) * 1000 / SDL_GetPerformanceFrequency()));
+        }
+        next_frame += ticks_per_frame;
+        if (next_frame < now) {
+            next_frame = now + ticks_per_frame;
+        }
+    }
+
+    int stopped = 0;
+    for (int i = 0; i < count; i++) {
+        if (systems[i].error != CHIP8_OK) {
+            printf("Instance %i: %s (opcode 0x%X at 0x%X)\n", i, chip8_error_string(systems[i].error),
+                   systems[i].current_op, systems[i].pc_reg);
+            stopped++;
+        }
+    }
+    printf("Wall: %i instances, %u frames, %u presents, %.1f tiles updated per present, %i stopped with an error\n",
+           count, frames, presents, presents > 0 ? (double)tiles_updated / presents : 0.0, stopped);
+
+    close_tile_atlas(&atlas);
+    close_window(window, renderer, texture);
+    free(systems);
+    free(budgets);
+}
 
 
 int main (int argc, char *argv[]) {
 
-    srand(time(NULL));  // seed the RNG
     int logging = FALSE;
     int timing = FALSE;
+    int muted = FALSE;
+    int wrap_sprites = FALSE;
+    int vsync = FALSE;
+    int latest_frame = FALSE;
+    int run_ahead = 0;
+    int wall = 0;
+    uint8_t quirks = QUIRKS_LEGACY;
+    TimingProfile cycle_timing = TIMING_FIXED;
+    long frame_cycles = 0;
+    int vblank_wait = FALSE;
+    const char *shm_name = NULL;
+    const char *record_path = NULL;
+    int gdb_port = 0;
+    uint32_t seed = (uint32_t)time(NULL);
+    int seed_given = FALSE;
+    int netplay_port = 0;
+    int netplay_peer_port = 0;
+    char netplay_host[64] = "";
+    int netplay_delay = 0;
+    int netplay_loss = 0;
+    Palette palette = {DEFAULT_FOREGROUND, DEFAULT_BACKGROUND};
 
-    if (argv[1] == NULL) {
-        printf("Program Usage: ./chip8 path/to/rom\n");
+    if (argc < 2) {
+        printf("Program Usage: ./chip8 path/to/rom [log] [time] [fg=RRGGBB] [bg=RRGGBB] [timing=NAME] [cycles=N] [vblank] [quirks=NAME] [wrap] [vsync] [latest] [runahead=N] [mute] [latency[=live]] [shm=/name] [record=FILE] [wall=N] [gdb=PORT] [seed=N] [netplay=LOCAL:HOST:PORT] [netdelay=MS] [netloss=PERCENT]\n");
         exit(EXIT_FAILURE);
     }
 
-    // check the command line argv[2] to see if logging or debug timing is enabled
-    if (argv[2] != NULL && strcmp(argv[2], "log") == 0) {logging = TRUE;}
-    if (argv[2] != NULL && strcmp(argv[2], "time") == 0) {timing = TRUE;}
+    // check the remaining command line arguments for logging, debug timing and colours
+    for (int i = 2; i < argc; i++) {
+        int valid = TRUE;
+
+        if (strcmp(argv[i], "log") == 0) {logging = TRUE;}
+        else if (strcmp(argv[i], "time") == 0) {timing = TRUE;}
+        else if (strcmp(argv[i], "mute") == 0) {muted = TRUE;}
+        else if (strcmp(argv[i], "wrap") == 0) {wrap_sprites = TRUE;}
+        else if (strcmp(argv[i], "vblank") == 0) {vblank_wait = TRUE;}
+        else if (strcmp(argv[i], "vsync") == 0) {vsync = TRUE;}
+        else if (strcmp(argv[i], "latest") == 0) {latest_frame = TRUE;}
+        else if (strncmp(argv[i], "runahead=", 9) == 0) {
+            run_ahead = atoi(argv[i] + 9);
+            valid = run_ahead > 0 && run_ahead <= RUN_AHEAD_MAX;
+        }
+        else if (strncmp(argv[i], "wall=", 5) == 0) {
+            wall = atoi(argv[i] + 5);
+            valid = wall > 0 && wall <= WALL_MAX;
+        }
+        else if (strncmp(argv[i], "cycles=", 7) == 0) {
+            frame_cycles = atol(argv[i] + 7);
+            valid = frame_cycles > 0;
+        }
+        else if (strncmp(argv[i], "timing=", 7) == 0) {
+            const TimingProfile *profile = find_timing_profile(argv[i] + 7);
+            if (profile != NULL) {cycle_timing = *profile;}
+            valid = profile != NULL;
+        }
+        else if (strncmp(argv[i], "quirks=", 7) == 0) {valid = parse_quirk_profile(argv[i] + 7, &quirks);}
+        else if (strcmp(argv[i], "latency") == 0) {init_latency(FALSE);}
+        else if (strcmp(argv[i], "latency=live") == 0) {init_latency(TRUE);}
+        else if (strncmp(argv[i], "shm=", 4) == 0) {shm_name = argv[i] + 4;}
+        else if (strncmp(argv[i], "record=", 7) == 0) {
+            record_path = argv[i] + 7;
+            valid = record_path[0] != '\0';
+        }
+        else if (strncmp(argv[i], "gdb=", 4) == 0) {
+            gdb_port = atoi(argv[i] + 4);
+            valid = gdb_port > 0 && gdb_port < 65536;
+        }
+        else if (strncmp(argv[i], "seed=", 5) == 0) {
+            seed = strtoul(argv[i] + 5, NULL, 0);
+            seed_given = TRUE;
+        }
+        else if (strncmp(argv[i], "netplay=", 8) == 0) {
+            valid = sscanf(argv[i] + 8, "%d:%63[^:]:%d", &netplay_port, netplay_host, &netplay_peer_port) == 3 &&
+                    netplay_port > 0 && netplay_port < 65536 && netplay_peer_port > 0 && netplay_peer_port < 65536;
+        }
+        else if (strncmp(argv[i], "netdelay=", 9) == 0) {
+            netplay_delay = atoi(argv[i] + 9);
+            valid = netplay_delay >= 0;
+        }
+        else if (strncmp(argv[i], "netloss=", 8) == 0) {
+            netplay_loss = atoi(argv[i] + 8);
+            valid = netplay_loss >= 0 && netplay_loss <= 100;
+        }
+        else if (strncmp(argv[i], "fg=", 3) == 0) {valid = parse_colour(argv[i] + 3, &palette.foreground);}
+        else if (strncmp(argv[i], "bg=", 3) == 0) {valid = parse_colour(argv[i] + 3, &palette.background);}
+        else {valid = FALSE;}
+
+        if (!valid) {
+            printf("ERROR: Unrecognized option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (netplay_port > 0 && gdb_port > 0) {
+        printf("ERROR: netplay and gdb can not be used together\n");
+        exit(EXIT_FAILURE);
+    }
+    // Netplay runs its frames through the api and rolls them back, the run ahead copy would not follow
+    if (netplay_port > 0 && run_ahead > 0) {
+        printf("ERROR: netplay and runahead can not be used together\n");
+        exit(EXIT_FAILURE);
+    }
+    // Both sides of a netplay game have to draw the same random numbers
+    if (netplay_port > 0 && !seed_given) {seed = DEFAULT_RNG_SEED;}
+    if (frame_cycles > 0) {cycle_timing.frame_cycles = frame_cycles;}
+    if (vblank_wait) {cycle_timing.display_wait = TRUE;}
+
+    if (wall > 0) {
+        if (logging || gdb_port > 0 || netplay_port > 0 || run_ahead > 0 || shm_name != NULL || record_path != NULL) {
+            printf("ERROR: wall can not be used with log, gdb, netplay, runahead, shm or record\n");
+            exit(EXIT_FAILURE);
+        }
+        run_wall(argv[1], wall, wrap_sprites ? quirks & ~QUIRK_CLIP : quirks, &cycle_timing, seed, vsync, palette);
+        return 0;
+    }
 
     Chip8 user_chip8;
     SDL_Window *chip8_screen;
     SDL_Renderer *chip8_renderer;
     SDL_Texture *chip8_texture;
     
-    // Used to track the cycles for clock speed
-    int division_cycles = 0;
+    // Cycles left to spend in the current frame, negative if the last instruction overran it
+    int32_t frame_budget = 0;
     int total_cycles = 0;
 
-    // Creates a buffer to store the pixel status for the emulator screen
-    uint32_t *pixel_buffer = malloc((SCREEN_HEIGHT * SCREEN_WIDTH) * sizeof(uint32_t));
-    
+    // Frames published for external readers (only with the shm option)
+    SharedFrame *shared_frame = NULL;
+
+    // Presented screens recorded on the encoder thread (only with the record option)
+    Recorder *recorder = NULL;
+
+    // Remote debugger (only with the gdb option)
+    Debugger *debugger = NULL;
+
+    // Rollback netplay with another emulator (only with the netplay option)
+    Netplay *netplay = NULL;
+
+    // Last buzzer state handed to the audio thread
+    int buzzer_on = FALSE;
+
+    // Screen changes by the rom and how many of them were presented, the rest were
+    // overwritten before the next display refresh
+    uint32_t screen_updates = 0;
+    uint32_t presents = 0;
+
+    // 60 Hz frames since the start, the time stamp of recorded screens
+    uint32_t frame_number = 0;
+
+    // Copy of the system the run ahead frames are emulated on (only with the runahead option),
+    // and what they cost in performance counter ticks
+    Chip8 run_ahead_chip8;
+    Uint64 run_ahead_ticks = 0;
+    Uint64 run_ahead_max_ticks = 0;
+    uint32_t run_ahead_frames = 0;
+
     // Setup the window
     SDL_Init(SDL_INIT_EVERYTHING);
-    init_window(&chip8_screen, &chip8_renderer, &chip8_texture);
+    init_window(&chip8_screen, &chip8_renderer, &chip8_texture, vsync);
+    set_palette(palette);
+    if (!muted) {init_audio();}
+    if (shm_name != NULL) {
+        shared_frame = create_shared_frame(shm_name);
+        if (shared_frame == NULL) {exit(EXIT_FAILURE);}
+    }
+    if (record_path != NULL) {
+        recorder = malloc(sizeof(Recorder));
+        if (!start_recorder(recorder, record_path)) {exit(EXIT_FAILURE);}
+    }
+    if (gdb_port > 0) {
+        debugger = malloc(sizeof(Debugger));
+        if (!init_debugger(debugger, gdb_port)) {exit(EXIT_FAILURE);}
+    }
+    if (netplay_port > 0) {
+        netplay = malloc(sizeof(Netplay));
+        if (!init_netplay(netplay, netplay_port, netplay_host, netplay_peer_port)) {exit(EXIT_FAILURE);}
+        set_netplay_conditions(netplay, netplay_delay, netplay_loss);
+    }
 
     // Initilize the emulator into its startup state and load rom into memory
     init_system(&user_chip8);
     load_rom(&user_chip8, argv[1]);
+    user_chip8.quirks = wrap_sprites ? quirks & ~QUIRK_CLIP : quirks;
+    seed_random(&user_chip8, seed);
+
+#ifdef CHIP8_AOT
+    init_aot();
+#endif
 
     /***************************************************************
-    * Main system loop begins here:
-    * 1: Single instruction is executed
-    * 2: Graphics are drawn to the screen (if draw flag set to true)
+    * Main system loop begins here, once per 60hz frame:
+    * 1: Instructions are executed until the frame's cycles are spent
+    * 2: Graphics are drawn to the screen (if the screen changed and the
+    *    display refreshed since the last present)
     * 3: User input is processed
     * 4: Timers are updated
+    * 5: Sleep until the next frame is due
     ****************************************************************/
+    const Uint64 ticks_per_frame = SDL_GetPerformanceFrequency() / FRAMES_PER_SECOND;
+    const Uint64 refresh_ticks = get_refresh_ticks(chip8_screen);
+    Uint64 next_frame = SDL_GetPerformanceCounter() + ticks_per_frame;
+    Uint64 presented_refresh = 0;
     time_t start = time(NULL);
+
     while(user_chip8.is_running_flag){
-        execute_instruction(&user_chip8, logging);
-        division_cycles++;
-        total_cycles++;
+        // Netplay runs the frame itself (rolling back first if the other side's keys were
+        // mispredicted), the same api frame on both sides whatever the timing profile
+        if (netplay != NULL) {
+            uint16_t local_keys = chip8_get_keys(&user_chip8);
+            total_cycles += netplay_advance(netplay, &user_chip8, local_keys) * CYCLES_PER_FRAME;
+
+            // The keyboard holds the keys of both players now, give the input handling back its own
+            chip8_set_keys(&user_chip8, local_keys);
+
+            if ((user_chip8.sound_timer > 0) != buzzer_on) {
+                buzzer_on = !buzzer_on;
+                set_buzzer(buzzer_on);
+            }
+        }
+        else {
+            frame_budget += cycle_timing.frame_cycles;
+        }
 
-        // DEBUG: Register printout if logging
-        if (logging) {print_regs(&user_chip8);}
+        // Breakpoints, watchpoints and stepping are only checked in frames that start with the
+        // debugger armed (it is only armed or disarmed between frames, by poll_debugger), so the
+        // plain loop has no per instruction test for it
+        if (debugger != NULL && debugger->is_armed) {
+            while (frame_budget > 0 && user_chip8.is_running_flag) {
+                int executed = debugger_execute(debugger, &user_chip8, logging);
 
-        // If the draw screen flag was set to true during the last 
-        // instruction, render the updated screen and then clear the flag
-        if (user_chip8.draw_screen_flag) {
-            buffer_graphics(&user_chip8, pixel_buffer, chip8_renderer);
-            draw_graphics(pixel_buffer, chip8_renderer, chip8_texture);
-            user_chip8.draw_screen_flag = FALSE;
+                // Stopped by the debugger, the rest of the frame is not used
+                if (executed == 0) {
+                    frame_budget = 0;
+                    break;
+                }
+                total_cycles += executed;
+                finish_instructions(&user_chip8, &cycle_timing, &user_chip8.current_op_id, executed, &frame_budget,
+                                    &screen_updates, &buzzer_on, logging);
+            }
+        }
+        else {
+            while (frame_budget > 0 && user_chip8.is_running_flag) {
+                const uint8_t *ops;
+#ifdef CHIP8_AOT
+                // Runs a whole translated block when there is one for the pc_reg. A DXYN is always
+                // the last instruction of one, so the display wait stops the frame right after it
+                int executed = execute_translated(&user_chip8, logging, &ops);
+#else
+                execute_instruction(&user_chip8, logging);
+                int executed = 1;
+                ops = &user_chip8.current_op_id;
+#endif
+                total_cycles += executed;
+                finish_instructions(&user_chip8, &cycle_timing, ops, executed, &frame_budget,
+                                    &screen_updates, &buzzer_on, logging);
+            }
+        }
+
+        // Run ahead: the next frames are emulated on a copy of the system with the keys held
+        // now, and the copy's screen is shown. The real system carries on from where it is, so
+        // the rom's own delay between reading a key and drawing the response is not seen
+        Chip8 *shown_chip8 = &user_chip8;
+        if (run_ahead > 0 && user_chip8.is_running_flag && (debugger == NULL || !debugger->is_armed)) {
+            Uint64 run_ahead_start = SDL_GetPerformanceCounter();
+            int32_t run_ahead_budget = frame_budget;
+
+            run_ahead_chip8 = user_chip8;
+            update_timers(&run_ahead_chip8);
+            for (int i = 0; i < run_ahead; i++) {
+                run_side_frame(&run_ahead_chip8, &cycle_timing, &run_ahead_budget);
+            }
+            shown_chip8 = &run_ahead_chip8;
+
+            Uint64 ticks = SDL_GetPerformanceCounter() - run_ahead_start;
+            run_ahead_ticks += ticks;
+            if (ticks > run_ahead_max_ticks) {run_ahead_max_ticks = ticks;}
+            run_ahead_frames++;
+        }
+
+        // If the screen changed, present the newest one once the display has refreshed since
+        // the last present. Until then the flag stays set and later frames overwrite the screen.
+        // With the latest option nothing is presented while the emulator is behind.
+        if (shown_chip8->draw_screen_flag) {
+            Uint64 now = SDL_GetPerformanceCounter();
+            Uint64 refresh = now / refresh_ticks;
+            int behind = latest_frame && now > next_frame;
+
+            if (refresh != presented_refresh && !behind) {
+                draw_graphics(shown_chip8, chip8_renderer, chip8_texture);
+                latency_frame_presented(chip8_screen);
+                if (recorder != NULL) {record_frame(recorder, shown_chip8, frame_number);}
+                user_chip8.draw_screen_flag = FALSE;
+                presented_refresh = refresh;
+                presents++;
+            }
         }
         
         // Store key input states and check for user exit and pause commands.
@@ -84,18 +537,40 @@ int main (int argc, char *argv[]) {
         // in this loop until the user clears the is_paused_flag or presses the esc key
         do {
             process_user_input(&user_chip8);
+
+            // Keep the buzzer quiet while paused, it is turned back on after the next instruction
+            if (user_chip8.is_paused_flag && buzzer_on) {
+                buzzer_on = FALSE;
+                set_buzzer(buzzer_on);
+            }
         } while (user_chip8.is_paused_flag && user_chip8.is_running_flag);
 
-        // Update the timers at a rate different from the CPU clock
-        // Orginal spec was ~60hz vs the ~540hz for the Chip8 machine
-        if (division_cycles == TIMER_CLOCK_DIVISION) {
-            update_timers(&user_chip8);
-            division_cycles = 0;
+        if (debugger != NULL) {poll_debugger(debugger, &user_chip8);}
+
+        // Update the timers once a frame (60hz), unless the debugger holds the emulator stopped
+        if (debugger == NULL || !debugger->is_stopped) {
+            // Netplay frames update the timers themselves
+            if (netplay == NULL) {update_timers(&user_chip8);}
+
+            if (shared_frame != NULL) {publish_shared_frame(shared_frame, &user_chip8);}
+
+            // Stop the buzzer on the tick the sound timer reaches 0
+            if (buzzer_on && user_chip8.sound_timer == 0) {
+                buzzer_on = FALSE;
+                set_buzzer(buzzer_on);
+            }
         }
 
-        // slow down the emulation clock speed
-        // TODO: Better way needed?
-        usleep(CPU_CLOCK_DELAY);
+        // Sleep until the next frame, if the host fell behind start counting again from now
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next_frame) {
+            SDL_Delay((Uint32)((next_frame - now) * 1000 / SDL_GetPerformanceFrequency()));
+        }
+        next_frame += ticks_per_frame;
+        if (next_frame < now) {
+            next_frame = now + ticks_per_frame;
+        }
+        frame_number++;
     }
     
     // DEBUG: CPU cycle timing measurement
@@ -104,11 +579,46 @@ int main (int argc, char *argv[]) {
         printf("Run time: %.2f\n", elapsed_time);
         printf("Cycles: %i\n", total_cycles);
         printf("Cycles Per Second: %i\n", (int)(total_cycles / elapsed_time));
+        printf("Screen updates: %u, presented: %u, coalesced: %u\n",
+               screen_updates, presents, screen_updates > presents ? screen_updates - presents : 0);
+
+        // Snapshot and speculative frames together, against the 60 Hz frame they have to fit in
+        if (run_ahead_frames > 0) {
+            double us_per_tick = 1000000.0 / SDL_GetPerformanceFrequency();
+            printf("Run ahead: %i frames, %.1f us average, %.1f us max per frame (frame is %.1f us)\n",
+                   run_ahead, us_per_tick * run_ahead_ticks / run_ahead_frames,
+                   us_per_tick * run_ahead_max_ticks, 1000000.0 / FRAMES_PER_SECOND);
+        }
     }
-    
+
+    // Input latency percentiles (only if enabled with the latency option)
+    print_latency_report();
+
+    if (netplay != NULL) {
+        print_netplay_report(netplay);
+        close_netplay(netplay);
+        free(netplay);
+    }
+
     // Close and destroy the window (only called when the program is exited)
+    close_audio();
+    if (shared_frame != NULL) {destroy_shared_frame(shared_frame, shm_name);}
+    if (recorder != NULL) {
+        stop_recorder(recorder);
+        free(recorder);
+    }
+    if (debugger != NULL) {
+        close_debugger(debugger);
+        free(debugger);
+    }
     close_window(chip8_screen, chip8_renderer, chip8_texture);
-    free(pixel_buffer);
+
+    // The rom stopped the system with an error instead of the user closing it
+    if (user_chip8.error != CHIP8_OK) {
+        printf("ERROR: %s (opcode 0x%X at 0x%X)\n", chip8_error_string(user_chip8.error),
+               user_chip8.current_op, user_chip8.pc_reg);
+        return EXIT_FAILURE;
+    }
 
     return 0;
 }
@@ -0,0 +1,30 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "state_hash.h"
+
+/*
+*
+* Ram reads and writes. Every system owns all of its ram, chip8_fork gives
+* the child its own copy, so a read is a plain load from ram.
+*
+* Writes also mark their 64 byte line in written_lines. Translated code
+* (aot.c) is only compared with ram again after a write to its lines.
+*
+*/
+
+static inline uint8_t read_ram(const Chip8 *chip8, uint16_t address) {
+    return chip8->ram[address & RAM_MASK];
+}
+
+
+// Writes a ram byte and updates the ram hash, the address wraps around at 4k
+static inline void write_ram(Chip8 *chip8, uint16_t address, uint8_t value) {
+    address &= RAM_MASK;
+    chip8->written_lines |= (uint64_t)1 << (address >> RAM_LINE_SHIFT);
+    chip8->ram_hash ^= ram_key(address, chip8->ram[address]) ^ ram_key(address, value);
+    chip8->ram[address] = value;
+}
+
+
+#endif // MEMORY_H
@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "netplay.h"
+
+/*
+* Packet layout (little endian):
+*   'C' '8'     magic
+*   start       4 bytes, frame of the first input
+*   ack         4 bytes, the sender knows our inputs of the frames before this
+*   count       1 byte, number of inputs
+*   inputs      2 bytes each, key masks of the frames start .. start + count - 1
+*/
+#define PACKET_HEADER_SIZE 11
+
+#define SLOT(frame) ((frame) & (NETPLAY_BUFFER - 1))
+
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+static void write_u32(uint8_t *data, uint32_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+
+static uint32_t read_u32(const uint8_t *data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+
+int init_netplay(Netplay *netplay, int local_port, const char *peer_host, int peer_port) {
+    memset(netplay, 0, sizeof(Netplay));
+    netplay->loss_state = DEFAULT_RNG_SEED ^ local_port;
+
+    memset(&netplay->peer, 0, sizeof(netplay->peer));
+    netplay->peer.sin_family = AF_INET;
+    netplay->peer.sin_port = htons(peer_port);
+    if (inet_pton(AF_INET, peer_host, &netplay->peer.sin_addr) != 1) {
+        printf("ERROR: %s is not an IPv4 address\n", peer_host);
+        return FALSE;
+    }
+
+    netplay->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (netplay->socket_fd < 0) {
+        perror("ERROR: Could not create netplay socket");
+        return FALSE;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(local_port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(netplay->socket_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("ERROR: Could not bind netplay port");
+        close(netplay->socket_fd);
+        return FALSE;
+    }
+    fcntl(netplay->socket_fd, F_SETFL, O_NONBLOCK);
+
+    printf("Netplay on port %i with %s:%i\n", local_port, peer_host, peer_port);
+    return TRUE;
+}
+
+
+// Latency and packet loss applied to the packets this side sends, for testing on loopback
+void set_netplay_conditions(Netplay *netplay, uint32_t delay_ms, uint32_t loss_percent) {
+    netplay->delay_ms = delay_ms;
+    netplay->loss_percent = loss_percent;
+}
+
+
+static void send_now(Netplay *netplay, const uint8_t *data, size_t size) {
+    sendto(netplay->socket_fd, data, size, 0, (struct sockaddr *)&netplay->peer, sizeof(netplay->peer));
+}
+
+
+// Sends the packets held back by the simulated latency whose time has come
+static void flush_delayed(Netplay *netplay) {
+    uint64_t now = monotonic_ms();
+    int kept = 0;
+
+    for (int i = 0; i < netplay->delayed_count; i++) {
+        DelayedPacket *packet = &netplay->delayed[i];
+        if (packet->due_ms <= now) {
+            send_now(netplay, packet->data, packet->size);
+        }
+        else {
+            netplay->delayed[kept++] = *packet;
+        }
+    }
+    netplay->delayed_count = kept;
+}
+
+
+// Sends every local input the remote side has not acknowledged yet
+static void send_inputs(Netplay *netplay) {
+    uint8_t data[NETPLAY_PACKET_SIZE];
+    uint32_t start = netplay->remote_acked;
+    uint32_t count = netplay->frame - start;
+
+    if (count > NETPLAY_BUFFER) {
+        start = netplay->frame - NETPLAY_BUFFER;
+        count = NETPLAY_BUFFER;
+    }
+
+    data[0] = 'C';
+    data[1] = '8';
+    write_u32(data + 2, start);
+    write_u32(data + 6, netplay->remote_confirmed);
+    data[10] = count;
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t keys = netplay->local_inputs[SLOT(start + i)];
+        data[PACKET_HEADER_SIZE + 2 * i] = keys;
+        data[PACKET_HEADER_SIZE + 2 * i + 1] = keys >> 8;
+    }
+    size_t size = PACKET_HEADER_SIZE + 2 * count;
+    netplay->packets_sent++;
+
+    // xorshift32, independent of the systems' generators
+    uint32_t state = netplay->loss_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    netplay->loss_state = state;
+    if (state % 100 < netplay->loss_percent) {
+        netplay->packets_dropped++;
+        return;
+    }
+
+    if (netplay->delay_ms == 0) {
+        send_now(netplay, data, size);
+    }
+    else if (netplay->delayed_count < NETPLAY_DELAY_QUEUE) {
+        DelayedPacket *packet = &netplay->delayed[netplay->delayed_count++];
+        memcpy(packet->data, data, size);
+        packet->size = size;
+        packet->due_ms = monotonic_ms() + netplay->delay_ms;
+    }
+    else {
+        netplay->packets_dropped++;
+    }
+}
+
+
+// Remote keys for a frame that has no input yet: the last keys received
+static uint16_t predict_remote(const Netplay *netplay) {
+    return netplay->remote_confirmed > 0 ? netplay->remote_inputs[SLOT(netplay->remote_confirmed - 1)] : 0;
+}
+
+
+// Runs the frame at netplay->frame, its starting state is saved first
+static void run_frame(Netplay *netplay, Chip8 *chip8) {
+    uint32_t frame = netplay->frame;
+
+    if (frame >= netplay->remote_confirmed) {
+        netplay->remote_inputs[SLOT(frame)] = predict_remote(netplay);
+    }
+    netplay->states[SLOT(frame)] = *chip8;
+
+    chip8_set_keys(chip8, netplay->local_inputs[SLOT(frame)] | netplay->remote_inputs[SLOT(frame)]);
+    chip8_step_frames(chip8, 1, NULL, NULL);
+    netplay->frame++;
+}
+
+
+/*
+* Restores the state saved at the start of the mispredicted frame and runs
+* the frames up to the current one again with the inputs known now
+*/
+static void roll_back(Netplay *netplay, Chip8 *chip8, uint32_t mispredicted) {
+    uint32_t current = netplay->frame;
+    uint32_t depth = current - mispredicted;
+
+    *chip8 = netplay->states[SLOT(mispredicted)];
+    netplay->frame = mispredicted;
+    while (netplay->frame < current) {
+        run_frame(netplay, chip8);
+    }
+
+    netplay->rollbacks++;
+    netplay->resimulated_frames += depth;
+    if (depth > netplay->max_rollback) {netplay->max_rollback = depth;}
+}
+
+
+/*
+* Reads the packets that arrived and rolls back to the first frame that ran
+* with a wrong prediction of the remote keys
+*/
+static void receive_inputs(Netplay *netplay, Chip8 *chip8) {
+    uint32_t mispredicted = netplay->frame;
+    uint8_t data[NETPLAY_PACKET_SIZE];
+    struct sockaddr_in sender;
+    socklen_t sender_length = sizeof(sender);
+    ssize_t received;
+
+    while ((received = recvfrom(netplay->socket_fd, data, sizeof(data), 0,
+                                (struct sockaddr *)&sender, &sender_length)) > 0) {
+        sender_length = sizeof(sender);
+        if (received < PACKET_HEADER_SIZE || data[0] != 'C' || data[1] != '8' ||
+            sender.sin_port != netplay->peer.sin_port ||
+            received < PACKET_HEADER_SIZE + 2 * data[10]) {
+            continue;
+        }
+        netplay->packets_received++;
+
+        uint32_t start = read_u32(data + 2);
+        uint32_t ack = read_u32(data + 6);
+        if (ack > netplay->remote_acked && ack <= netplay->frame) {
+            netplay->remote_acked = ack;
+        }
+
+        // Inputs are taken in order, a gap is filled by a later packet since the ack does not move
+        for (uint32_t i = 0; i < data[10]; i++) {
+            uint32_t frame = start + i;
+            if (frame != netplay->remote_confirmed || frame >= netplay->frame + NETPLAY_BUFFER / 2) {
+                continue;
+            }
+
+            uint16_t keys = data[PACKET_HEADER_SIZE + 2 * i] | data[PACKET_HEADER_SIZE + 2 * i + 1] << 8;
+            if (frame < netplay->frame && keys != netplay->remote_inputs[SLOT(frame)] && frame < mispredicted) {
+                mispredicted = frame;
+            }
+            netplay->remote_inputs[SLOT(frame)] = keys;
+            netplay->remote_confirmed++;
+        }
+    }
+
+    if (mispredicted < netplay->frame) {
+        roll_back(netplay, chip8, mispredicted);
+    }
+}
+
+
+/*
+* Services the connection without running a new frame: sends held back
+* packets, reads the remote inputs, rolls back and runs the frames again
+* if a prediction was wrong, and resends unacknowledged inputs
+*/
+void poll_netplay(Netplay *netplay, Chip8 *chip8) {
+    flush_delayed(netplay);
+
+    receive_inputs(netplay, chip8);
+
+    send_inputs(netplay);
+}
+
+
+/*
+* Runs the next frame with the local keys, unless this side is too far ahead
+* of the remote input. Returns the number of frames run (0 or 1)
+*/
+int netplay_advance(Netplay *netplay, Chip8 *chip8, uint16_t local_keys) {
+    flush_delayed(netplay);
+
+    receive_inputs(netplay, chip8);
+
+    if (netplay->frame >= netplay->remote_confirmed + NETPLAY_MAX_ROLLBACK) {
+        netplay->stalls++;
+        send_inputs(netplay);
+        return 0;
+    }
+
+    netplay->local_inputs[SLOT(netplay->frame)] = local_keys;
+    run_frame(netplay, chip8);
+    send_inputs(netplay);
+    return 1;
+}
+
+
+void print_netplay_report(const Netplay *netplay) {
+    printf("Netplay: %u frames, %u rollbacks (%u frames run again, deepest %u), %u frames waited\n",
+           netplay->frame, netplay->rollbacks, netplay->resimulated_frames, netplay->max_rollback, netplay->stalls);
+    printf("Packets: %u sent, %u dropped, %u received\n",
+           netplay->packets_sent, netplay->packets_dropped, netplay->packets_received);
+}
+
+
+void close_netplay(Netplay *netplay) {
+    close(netplay->socket_fd);
+}
@@ -0,0 +1,75 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <netinet/in.h>
+#include "api.h"
+
+/*
+*
+* Rollback netplay for two emulators over UDP. Both sides run the same rom
+* from the same seed, the keys pressed on either side are combined (OR) and
+* seen by both systems, so each player uses the keys of their paddle.
+*
+* Every frame runs at once with the local keys and a prediction of the
+* remote keys (the last ones received). When the real remote keys arrive
+* and differ from the prediction, the state saved at the start of that
+* frame is restored and the frames up to the current one are run again.
+* A side that gets NETPLAY_MAX_ROLLBACK frames ahead of the remote input
+* waits for it.
+*
+* Packets carry every local input the other side has not acknowledged, so
+* lost packets are covered by the next ones. Latency and packet loss can be
+* simulated on the sending side to test on loopback.
+*
+* Netplay frames are api frames (CYCLES_PER_FRAME instructions and a timer
+* update), the same on both sides whatever timing the frontend uses.
+*
+*/
+
+#define NETPLAY_MAX_ROLLBACK 15             // frames a side may run ahead of the remote input
+#define NETPLAY_BUFFER 32                   // frames of inputs and states kept, a power of 2
+#define NETPLAY_PACKET_SIZE (11 + 2 * NETPLAY_BUFFER)
+#define NETPLAY_DELAY_QUEUE 256             // packets held back by the simulated latency
+
+typedef struct {
+    uint8_t data[NETPLAY_PACKET_SIZE];
+    size_t size;
+    uint64_t due_ms;                        // when the packet is really sent
+} DelayedPacket;
+
+typedef struct {
+    int socket_fd;
+    struct sockaddr_in peer;
+
+    uint32_t frame;                         // next frame to run
+    uint32_t remote_confirmed;              // the remote inputs of the frames before this are known
+    uint32_t remote_acked;                  // the remote side knows our inputs of the frames before this
+    uint16_t local_inputs[NETPLAY_BUFFER];
+    uint16_t remote_inputs[NETPLAY_BUFFER]; // received, or predicted from frame remote_confirmed on
+    Chip8 states[NETPLAY_BUFFER];           // state at the start of each frame
+
+    // Simulated network conditions of the packets this side sends
+    uint32_t delay_ms;
+    uint32_t loss_percent;
+    uint32_t loss_state;
+    DelayedPacket delayed[NETPLAY_DELAY_QUEUE];
+    int delayed_count;
+
+    uint32_t rollbacks;
+    uint32_t resimulated_frames;
+    uint32_t max_rollback;
+    uint32_t stalls;                        // frames spent waiting for the remote input
+    uint32_t packets_sent;
+    uint32_t packets_dropped;
+    uint32_t packets_received;
+} Netplay;
+
+int init_netplay(Netplay *netplay, int local_port, const char *peer_host, int peer_port);
+void set_netplay_conditions(Netplay *netplay, uint32_t delay_ms, uint32_t loss_percent);
+void poll_netplay(Netplay *netplay, Chip8 *chip8);
+int netplay_advance(Netplay *netplay, Chip8 *chip8, uint16_t local_keys);
+void print_netplay_report(const Netplay *netplay);
+void close_netplay(Netplay *netplay);
+
+
+#endif // NETPLAY_H
@@ -0,0 +1,117 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "pool.h"
+
+CHIP8_STATIC_ASSERT(sizeof(Chip8) % CACHE_LINE_SIZE == 0, pooled_systems_stay_aligned);
+CHIP8_STATIC_ASSERT(POOL_ARENA_SYSTEMS > 0, a_system_fits_an_arena);
+
+
+/*
+* Maps a 2 MB aligned arena, from the hugetlbfs pool if it has a page free,
+* otherwise as normal memory that transparent huge pages may back.
+* Returns NULL if out of memory
+*/
+static uint8_t *map_arena(int *huge) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+    void *pages = mmap(NULL, POOL_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (pages != MAP_FAILED) {
+        *huge = TRUE;
+        return pages;
+    }
+#endif
+    *huge = FALSE;
+
+    // A huge page needs the arena aligned to its size, map twice as much and trim
+    uint8_t *mapping = mmap(NULL, 2 * POOL_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *arena = (uint8_t *)(((uintptr_t)mapping + POOL_ARENA_SIZE - 1) & ~(uintptr_t)(POOL_ARENA_SIZE - 1));
+    if (arena > mapping) {
+        munmap(mapping, arena - mapping);
+    }
+    munmap(arena + POOL_ARENA_SIZE, mapping + POOL_ARENA_SIZE - arena);
+
+#ifdef MADV_HUGEPAGE
+    madvise(arena, POOL_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+    return arena;
+}
+
+
+// Adds an arena and puts its systems on the free list, returns FALSE if out of memory
+static int grow_pool(Chip8Pool *pool) {
+    if (pool->arena_count == pool->arena_capacity) {
+        uint32_t capacity = pool->arena_capacity > 0 ? 2 * pool->arena_capacity : 8;
+        uint8_t **arenas = realloc(pool->arenas, capacity * sizeof(uint8_t *));
+        if (arenas == NULL) {
+            return FALSE;
+        }
+        pool->arenas = arenas;
+        pool->arena_capacity = capacity;
+    }
+
+    int huge;
+    uint8_t *arena = map_arena(&huge);
+    if (arena == NULL) {
+        return FALSE;
+    }
+    pool->arenas[pool->arena_count++] = arena;
+    pool->huge_arenas += huge;
+
+    // First touch, the pages come from the NUMA node of this thread
+    memset(arena, 0, POOL_ARENA_SIZE);
+
+    // Pushed from the end so systems are handed out in address order
+    for (size_t i = POOL_ARENA_SYSTEMS; i-- > 0;) {
+        void *system = arena + i * sizeof(Chip8);
+        *(void **)system = pool->free_list;
+        pool->free_list = system;
+    }
+    return TRUE;
+}
+
+
+void init_pool(Chip8Pool *pool) {
+    memset(pool, 0, sizeof(Chip8Pool));
+}
+
+
+/*
+* Takes a system from the pool, mapping another arena if it is empty.
+* The system is not initialized. Returns NULL if out of memory
+*/
+Chip8 *pool_alloc(Chip8Pool *pool) {
+    if (pool->free_list == NULL && !grow_pool(pool)) {
+        return NULL;
+    }
+
+    void *system = pool->free_list;
+    pool->free_list = *(void **)system;
+    pool->in_use++;
+    return system;
+}
+
+
+// Gives a system back to the pool it came from, NULL is ignored like free
+void pool_free(Chip8Pool *pool, Chip8 *chip8) {
+    if (chip8 == NULL) {return;}
+
+    *(void **)chip8 = pool->free_list;
+    pool->free_list = chip8;
+    pool->in_use--;
+}
+
+
+// Unmaps every arena, the systems taken from the pool are gone afterwards
+void close_pool(Chip8Pool *pool) {
+    for (uint32_t i = 0; i < pool->arena_count; i++) {
+        munmap(pool->arenas[i], POOL_ARENA_SIZE);
+    }
+    free(pool->arenas);
+    init_pool(pool);
+}
@@ -0,0 +1,42 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include "chip8_t.h"
+
+/*
+*
+* Pool of systems for batch runs that keep thousands of them alive.
+*
+* Systems are carved out of 2 MB arenas, each mapped on its own huge page
+* when the kernel has one to give (hugetlbfs pages first, then transparent
+* huge pages), so a few hundred systems cost one TLB entry instead of
+* hundreds. An arena is touched as soon as it is mapped, by the thread that
+* grows the pool, and the kernel places it on that thread's NUMA node.
+*
+* A pool belongs to one thread: it has no locks, and only the thread that
+* allocates from it should run its systems. Freed systems go back to the
+* pool, arenas are only unmapped by close_pool.
+*
+*/
+
+#define POOL_ARENA_SIZE (2 * 1024 * 1024)
+#define POOL_ARENA_SYSTEMS (POOL_ARENA_SIZE / sizeof(Chip8))
+
+typedef struct {
+    uint8_t **arenas;
+    uint32_t arena_count;
+    uint32_t arena_capacity;
+    uint32_t huge_arenas;                   // arenas mapped from hugetlbfs, the rest may get transparent huge pages
+
+    void *free_list;                        // a free system holds the next one in its first bytes
+    uint32_t in_use;
+} Chip8Pool;
+
+void init_pool(Chip8Pool *pool);
+Chip8 *pool_alloc(Chip8Pool *pool);
+void pool_free(Chip8Pool *pool, Chip8 *chip8);
+void close_pool(Chip8Pool *pool);
+
+
+#endif // POOL_H
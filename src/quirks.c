@@ -0,0 +1,40 @@
+#include <string.h>
+#include "quirks.h"
+
+
+typedef struct {
+    const char *name;
+    uint8_t quirks;
+} QuirkProfile;
+
+static const QuirkProfile PROFILES[] = {
+    {"legacy", QUIRKS_LEGACY},
+    {"vip", QUIRKS_VIP},
+    {"schip", QUIRKS_SCHIP},
+    {"xochip", QUIRKS_XOCHIP},
+};
+
+#define PROFILE_COUNT ((int)(sizeof(PROFILES) / sizeof(PROFILES[0])))
+
+
+// Looks up a profile by name, returns FALSE if there is no such profile
+int parse_quirk_profile(const char *name, uint8_t *quirks) {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(name, PROFILES[i].name) == 0) {
+            *quirks = PROFILES[i].quirks;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+// Name of the profile with exactly these quirks, or NULL if it is a custom combination
+const char *quirk_profile_name(uint8_t quirks) {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (PROFILES[i].quirks == quirks) {
+            return PROFILES[i].name;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,198 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include "instructions.h"
+#include "memory.h"
+
+/*
+*
+* Instructions whose behaviour depends on the quirk profile.
+*
+* Each one is written once here with the quirks as a parameter. The
+* handlers in instructions.c pass chip8->quirks, while the interpreter
+* (execute_instruction) instantiates every quirk combination with the
+* quirks as a constant, so the checks below are folded away at compile
+* time and cost nothing in the dispatch loop.
+*
+*/
+
+#define QUIRK_INLINE static inline __attribute__((always_inline))
+
+
+int parse_quirk_profile(const char *name, uint8_t *quirks);
+const char *quirk_profile_name(uint8_t quirks);
+
+
+/*
+* Opcodes 8XY1, 8XY2, 8XY3: OR, AND, XOR Vx, Vy
+* V[X] op V[Y] result stored in V[X], the VIP also clears V[F]
+*/
+QUIRK_INLINE void or_Vx_Vy_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+
+    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] | chip8->V[target_v_reg_y]);
+    if (quirks & QUIRK_VF_RESET) {chip8->V[0xF] = 0;}
+    chip8->pc_reg += 2;
+}
+
+QUIRK_INLINE void and_Vx_Vy_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+
+    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] & chip8->V[target_v_reg_y]);
+    if (quirks & QUIRK_VF_RESET) {chip8->V[0xF] = 0;}
+    chip8->pc_reg += 2;
+}
+
+QUIRK_INLINE void xor_Vx_Vy_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+
+    chip8->V[target_v_reg_x] = (chip8->V[target_v_reg_x] ^ chip8->V[target_v_reg_y]);
+    if (quirks & QUIRK_VF_RESET) {chip8->V[0xF] = 0;}
+    chip8->pc_reg += 2;
+}
+
+
+/*
+* Opcode 8XY6: SHR Vx {, Vy}
+* V[X] = V[X] >> 1 (or V[Y] >> 1 on the VIP)
+* V[F] is set to the bit shifted out
+*/
+QUIRK_INLINE void shr_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+    uint8_t value = chip8->V[(quirks & QUIRK_SHIFT_VY) ? target_v_reg_y : target_v_reg_x];
+
+    chip8->V[0xF] = value & 0x01;
+    chip8->V[target_v_reg_x] = value >> 1;
+    chip8->pc_reg += 2;
+}
+
+
+/*
+* Opcode 8XYE: SHL Vx {, Vy}
+* V[X] = V[X] << 1 (or V[Y] << 1 on the VIP)
+* V[F] is set to the bit shifted out, in every profile (before the
+* profiles it was always cleared, see QUIRKS_LEGACY)
+*/
+QUIRK_INLINE void shl_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+    uint8_t value = chip8->V[(quirks & QUIRK_SHIFT_VY) ? target_v_reg_y : target_v_reg_x];
+
+    chip8->V[0xF] = value >> 7;
+    chip8->V[target_v_reg_x] = value << 1;
+    chip8->pc_reg += 2;
+}
+
+
+/*
+* Opcode BNNN: Jump + V[0]
+* set pc_register to NNN + V[0] (XNN + V[X] on the SUPER-CHIP)
+*/
+QUIRK_INLINE void jump_V0_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint16_t nnn = chip8->current_op & 0x0FFF;
+    uint8_t target_v_reg = (quirks & QUIRK_JUMP_VX) ? (chip8->current_op & 0x0F00) >> 8 : 0;
+
+    chip8->pc_reg = (nnn + chip8->V[target_v_reg]);
+}
+
+
+/*
+* Opcode DXYN: Display N-byte sprite at ram[I_reg]
+* Draws sprite at location V[X], V[Y]. Set V[F] if collision
+*
+* The start location wraps around the screen. The rest of the sprite is
+* clipped at the screen edge with QUIRK_CLIP, otherwise it wraps as well.
+* The clipped size is worked out once per sprite, so the pixel loop has no
+* bounds checks and sets the pixels and collision without branches. Only
+* the pixels under set sprite bits flip, so only their keys go into the
+* screen hash, found with a count of trailing zeros.
+*
+* Initial source of implimentation used as template found below:
+* http://www.multigesture.net/articles/how-to-write-an-emulator-chip-8-interpreter/
+*/
+QUIRK_INLINE void drw_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t target_v_reg_x = (chip8->current_op & 0x0F00) >> 8;
+    uint8_t target_v_reg_y = (chip8->current_op & 0x00F0) >> 4;
+    uint8_t sprite_height = chip8->current_op & 0x000F;
+    uint8_t x_location = chip8->V[target_v_reg_x] & (SCREEN_WIDTH - 1);
+    uint8_t y_location = chip8->V[target_v_reg_y] & (SCREEN_HEIGHT - 1);
+    int rows = sprite_height;
+    int columns = 8;
+    uint8_t collision = FALSE;
+
+    if (quirks & QUIRK_CLIP) {
+        if (rows > SCREEN_HEIGHT - y_location) {rows = SCREEN_HEIGHT - y_location;}
+        if (columns > SCREEN_WIDTH - x_location) {columns = SCREEN_WIDTH - x_location;}
+    }
+
+    uint64_t screen_hash = chip8->screen_hash;
+
+    for (int y_coordinate = 0; y_coordinate < rows; y_coordinate++) {
+        uint8_t sprite_row = read_ram(chip8, chip8->I_reg + y_coordinate);
+        unsigned row = (y_location + y_coordinate) & (SCREEN_HEIGHT - 1);
+        uint8_t *screen_row = chip8->screen[row];
+
+        for (int x_coordinate = 0; x_coordinate < columns; x_coordinate++) {
+            uint8_t pixel = (sprite_row >> (7 - x_coordinate)) & 1;
+            unsigned column = (x_location + x_coordinate) & (SCREEN_WIDTH - 1);
+            uint8_t *screen_pixel = &screen_row[column];
+
+            collision |= *screen_pixel & pixel;
+            *screen_pixel ^= pixel;
+        }
+
+        // Bit 7 - x_coordinate of the row is the pixel at x_coordinate
+        unsigned flipped = sprite_row & (0xFF << (8 - columns));
+        while (flipped != 0) {
+            unsigned column = (x_location + 7 - __builtin_ctz(flipped)) & (SCREEN_WIDTH - 1);
+            screen_hash ^= pixel_key(row * SCREEN_WIDTH + column);
+            flipped &= flipped - 1;
+        }
+    }
+
+    chip8->screen_hash = screen_hash;
+    chip8->V[0xF] = collision;
+    chip8->draw_screen_flag = TRUE;
+    chip8->pc_reg += 2;
+}
+
+
+/*
+* Opcode FX55: LD [I], Vx
+* Store V[0] - V[X] in memory starting at I_reg value,
+* the VIP leaves I_reg pointing after the last register
+*/
+QUIRK_INLINE void st_V_regs_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t end_ld_v_reg = (chip8->current_op & 0x0F00) >> 8;
+
+    for (int i = 0; i <= end_ld_v_reg; i++) {
+        write_ram(chip8, chip8->I_reg + i, chip8->V[i]);
+    }
+
+    if (quirks & QUIRK_INCREMENT_I) {chip8->I_reg += (end_ld_v_reg + 1);}
+    chip8->pc_reg += 2;
+}
+
+
+/*
+* Opcode FX65: LD Vx, I
+* Read values into V[0] - V[X] from memory starting at I_reg value,
+* the VIP leaves I_reg pointing after the last register
+*/
+QUIRK_INLINE void ld_V_regs_quirks(Chip8 *chip8, const unsigned quirks) {
+    uint8_t end_ld_v_reg = (chip8->current_op & 0x0F00) >> 8;
+
+    for (int i = 0; i <= end_ld_v_reg; i++) {
+        chip8->V[i] = read_ram(chip8, chip8->I_reg + i);
+    }
+
+    if (quirks & QUIRK_INCREMENT_I) {chip8->I_reg += (end_ld_v_reg + 1);}
+    chip8->pc_reg += 2;
+}
+
+
+#endif // QUIRKS_H
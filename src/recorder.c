@@ -0,0 +1,90 @@
+#include <string.h>
+#include "recorder.h"
+#include "api.h"
+
+
+// Encoder thread: writes out the queued frames until stopped and the queue is empty
+static int encode_frames(void *data) {
+    Recorder *recorder = data;
+
+    for (;;) {
+        uint32_t tail = recorder->tail;
+        uint32_t head = __atomic_load_n(&recorder->head, __ATOMIC_ACQUIRE);
+
+        if (tail == head) {
+            if (__atomic_load_n(&recorder->stopping, __ATOMIC_ACQUIRE)) {
+                // Frames pushed before stopping was set are visible now
+                if (tail == __atomic_load_n(&recorder->head, __ATOMIC_ACQUIRE)) {break;}
+                continue;
+            }
+            SDL_Delay(RECORDER_POLL_MS);
+            continue;
+        }
+
+        for (; tail != head; tail++) {
+            const RecordedFrame *frame = &recorder->queue[tail & (RECORDER_QUEUE - 1)];
+            if (!recorder->failed && !write_video_frame(&recorder->writer, frame->screen, frame->frame_number)) {
+                recorder->failed = TRUE;
+            }
+        }
+        __atomic_store_n(&recorder->tail, tail, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+
+// Creates the recording and starts the encoder thread, returns FALSE if either fails
+int start_recorder(Recorder *recorder, const char *path) {
+    memset(recorder, 0, sizeof(Recorder));
+
+    if (!open_video_writer(&recorder->writer, path)) {
+        printf("ERROR: Could not create recording %s\n", path);
+        return FALSE;
+    }
+
+    recorder->thread = SDL_CreateThread(encode_frames, "chip8 recorder", recorder);
+    if (recorder->thread == NULL) {
+        printf("ERROR: Could not start the recording thread: %s\n", SDL_GetError());
+        close_video_writer(&recorder->writer);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/*
+* Queues the screen of the system, shown at the given 60 Hz frame number.
+* Never waits, the frame is dropped if the encoder is a whole queue behind
+*/
+void record_frame(Recorder *recorder, const Chip8 *chip8, uint32_t frame_number) {
+    uint32_t head = recorder->head;
+
+    if (head - __atomic_load_n(&recorder->tail, __ATOMIC_ACQUIRE) == RECORDER_QUEUE) {
+        recorder->dropped++;
+        return;
+    }
+
+    RecordedFrame *frame = &recorder->queue[head & (RECORDER_QUEUE - 1)];
+    frame->frame_number = frame_number;
+    chip8_get_screen_packed(chip8, frame->screen);
+    __atomic_store_n(&recorder->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+// Writes out the frames still queued, closes the recording and reports its size
+void stop_recorder(Recorder *recorder) {
+    __atomic_store_n(&recorder->stopping, TRUE, __ATOMIC_RELEASE);
+    SDL_WaitThread(recorder->thread, NULL);
+
+    if (!close_video_writer(&recorder->writer)) {
+        recorder->failed = TRUE;
+    }
+
+    if (recorder->failed) {
+        printf("ERROR: Could not write the recording, it is incomplete\n");
+    }
+    printf("Recording: %u frames in %llu bytes (%.1f bytes per frame), %u dropped\n",
+           recorder->writer.frames, (unsigned long long)recorder->writer.bytes,
+           recorder->writer.frames > 0 ? (double)recorder->writer.bytes / recorder->writer.frames : 0.0,
+           recorder->dropped);
+}
@@ -0,0 +1,42 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <SDL2/SDL.h>
+#include "video.h"
+
+/*
+*
+* Records the presented screens to a .c8v file (see video.h) on a thread
+* of its own. The emulation thread only packs the screen into a single
+* producer, single consumer queue, the encoder thread compresses and
+* writes the frames. Neither side waits for the other: a frame that finds
+* the queue full is dropped and counted.
+*
+*/
+
+#define RECORDER_QUEUE 64                   // frames, a power of 2
+#define RECORDER_POLL_MS 5                  // encoder sleep while the queue is empty
+
+typedef struct {
+    uint32_t frame_number;
+    uint8_t screen[VIDEO_FRAME_SIZE];
+} RecordedFrame;
+
+typedef struct {
+    RecordedFrame queue[RECORDER_QUEUE];
+    uint32_t head;                          // frames pushed, written by the emulation thread
+    uint32_t tail;                          // frames encoded, written by the encoder thread
+    int stopping;
+    int failed;                             // a write failed, the rest of the frames are thrown away
+    uint32_t dropped;                       // frames that found the queue full
+
+    VideoWriter writer;
+    SDL_Thread *thread;
+} Recorder;
+
+int start_recorder(Recorder *recorder, const char *path);
+void record_frame(Recorder *recorder, const Chip8 *chip8, uint32_t frame_number);
+void stop_recorder(Recorder *recorder);
+
+
+#endif // RECORDER_H
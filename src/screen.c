@@ -1,10 +1,18 @@
 #include "screen.h"
 
 
+// Colours used when converting the screen to RGBA pixels
+static Palette screen_palette = {DEFAULT_FOREGROUND, DEFAULT_BACKGROUND};
+
+// TRUE if the texture can be locked and written in place, otherwise the
+// screen is expanded into fallback_buffer and copied with SDL_UpdateTexture
+static int streaming_texture = FALSE;
+static uint32_t fallback_buffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+
 
 // TODO: the double pointer and the dereference is a bit messy,
 // try to refactor if possible or at least clean up
-void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **texture) {
+void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **texture, int vsync) {
     (*window) = SDL_CreateWindow(
         "CHIP-8",                          // window label
         SDL_WINDOWPOS_CENTERED,            // initial x position
@@ -23,7 +31,8 @@ void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **tex
         exit(1);
     }
 
-    (*renderer) = SDL_CreateRenderer((*window), -1, 0);
+    // With vsync a present waits for the display refresh instead of tearing
+    (*renderer) = SDL_CreateRenderer((*window), -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
     
     // Check that the renderer was successfully created
     if (*renderer == NULL) {
@@ -31,18 +40,34 @@ void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **tex
         exit(1);
     }
 
+    // The screen is expanded straight into the memory of a streaming texture,
+    // renderers that can not stream get a target texture updated from a copy
     (*texture) = SDL_CreateTexture((*renderer), 
         SDL_PIXELFORMAT_RGBA8888, 
-        SDL_TEXTUREACCESS_TARGET, 
+        SDL_TEXTUREACCESS_STREAMING, 
         SCREEN_WIDTH, 
         SCREEN_HEIGHT
     );
+    streaming_texture = (*texture) != NULL;
+
+    if (!streaming_texture) {
+        (*texture) = SDL_CreateTexture((*renderer), 
+            SDL_PIXELFORMAT_RGBA8888, 
+            SDL_TEXTUREACCESS_TARGET, 
+            SCREEN_WIDTH, 
+            SCREEN_HEIGHT
+        );
+    }
 
     // Check that the texture was successfully created
     if (*texture == NULL) {
         printf("Could not create SDL Texture: %s\n", SDL_GetError());
         exit(1);
     }
+
+    // Scale the screen by whole pixels, the rest of the window is left black
+    SDL_RenderSetLogicalSize(*renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
+    SDL_RenderSetIntegerScale(*renderer, SDL_TRUE);
     
     // Set the screen to black initially
     SDL_SetRenderDrawColor(*renderer, 0, 0, 0, 0);
@@ -51,24 +76,139 @@ void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **tex
 }
 
 
-void buffer_graphics(Chip8 *chip8, uint32_t *buffer, SDL_Renderer *renderer) {
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
-        for (int x = 0; x < SCREEN_WIDTH; x++) {
-            uint8_t pixel = chip8->screen[y][x];
-            buffer[(y * SCREEN_WIDTH) + x] = (0xFFFFFF00 * pixel) | 0x000000FF;
-        }
+/*
+* Performance counter ticks between two refreshes of the display the window
+* is on, 60 Hz is assumed if the display does not report its refresh rate
+*/
+Uint64 get_refresh_ticks(SDL_Window *window) {
+    SDL_DisplayMode mode;
+    int refresh_rate = 60;
+
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0) {
+        refresh_rate = mode.refresh_rate;
     }
+    return SDL_GetPerformanceFrequency() / refresh_rate;
 }
 
 
-void draw_graphics(uint32_t *buffer, SDL_Renderer *renderer, SDL_Texture *texture) {
-    SDL_UpdateTexture(texture, NULL, buffer, SCREEN_WIDTH * sizeof(uint32_t));
+void set_palette(Palette palette) {
+    screen_palette = palette;
+}
+
+
+/*
+* Converts the chip8 screen to RGBA pixels and presents it. With a streaming
+* texture the pixels are written straight into the locked texture memory
+*/
+void draw_graphics(Chip8 *chip8, SDL_Renderer *renderer, SDL_Texture *texture) {
+    void *pixels;
+    int pitch;
+
+    if (streaming_texture && SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+        expand_screen(chip8, pixels, pitch / sizeof(uint32_t), screen_palette);
+        SDL_UnlockTexture(texture);
+    }
+    else {
+        expand_screen(chip8, fallback_buffer, SCREEN_WIDTH, screen_palette);
+        SDL_UpdateTexture(texture, NULL, fallback_buffer, SCREEN_WIDTH * sizeof(uint32_t));
+    }
+
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
 }
 
 
+/*
+* Creates one texture with a tile for the screen of each of count systems,
+* in a grid about as wide as it is high, and shows it in the whole window.
+* The tiles are smaller than a pixel when there are many of them, so the
+* scale is not kept whole. Returns FALSE if the texture can not be created
+*/
+int init_tile_atlas(SDL_Renderer *renderer, TileAtlas *atlas, int count) {
+    atlas->count = count;
+    atlas->columns = 1;
+    while (atlas->columns * atlas->columns < count) {
+        atlas->columns++;
+    }
+    atlas->rows = (count + atlas->columns - 1) / atlas->columns;
+
+    int width = atlas->columns * (SCREEN_WIDTH + TILE_GAP) - TILE_GAP;
+    int height = atlas->rows * (SCREEN_HEIGHT + TILE_GAP) - TILE_GAP;
+
+    // Same choice of texture as init_window
+    atlas->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    streaming_texture = atlas->texture != NULL;
+    if (!streaming_texture) {
+        atlas->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    }
+    if (atlas->texture == NULL) {
+        printf("Could not create SDL Texture: %s\n", SDL_GetError());
+        return FALSE;
+    }
+
+    // The gaps and the tiles after the last system are never drawn, start from the background
+    uint32_t *background = malloc(sizeof(uint32_t) * width * height);
+    if (background == NULL) {
+        printf("ERROR: Out of memory\n");
+        return FALSE;
+    }
+    for (int i = 0; i < width * height; i++) {
+        background[i] = screen_palette.background;
+    }
+    SDL_UpdateTexture(atlas->texture, NULL, background, width * sizeof(uint32_t));
+    free(background);
+
+    SDL_RenderSetLogicalSize(renderer, width, height);
+    SDL_RenderSetIntegerScale(renderer, SDL_FALSE);
+    return TRUE;
+}
+
+
+/*
+* Updates the tiles of the systems that drew since their tile was last
+* updated and presents the whole atlas once. Nothing is presented if no
+* system drew. Returns the number of tiles updated
+*/
+int draw_tiles(Chip8 *systems, int count, SDL_Renderer *renderer, TileAtlas *atlas) {
+    int updated = 0;
+
+    for (int i = 0; i < count && i < atlas->count; i++) {
+        Chip8 *chip8 = &systems[i];
+        if (!chip8->draw_screen_flag) {continue;}
+
+        SDL_Rect tile = {(i % atlas->columns) * (SCREEN_WIDTH + TILE_GAP), (i / atlas->columns) * (SCREEN_HEIGHT + TILE_GAP),
+                         SCREEN_WIDTH, SCREEN_HEIGHT};
+        void *pixels;
+        int pitch;
+
+        // Only the locked tile is uploaded
+        if (streaming_texture && SDL_LockTexture(atlas->texture, &tile, &pixels, &pitch) == 0) {
+            expand_screen(chip8, pixels, pitch / sizeof(uint32_t), screen_palette);
+            SDL_UnlockTexture(atlas->texture);
+        }
+        else {
+            expand_screen(chip8, fallback_buffer, SCREEN_WIDTH, screen_palette);
+            SDL_UpdateTexture(atlas->texture, &tile, fallback_buffer, SCREEN_WIDTH * sizeof(uint32_t));
+        }
+        chip8->draw_screen_flag = FALSE;
+        updated++;
+    }
+
+    if (updated > 0) {
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, atlas->texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
+    return updated;
+}
+
+
+void close_tile_atlas(TileAtlas *atlas) {
+    SDL_DestroyTexture(atlas->texture);
+}
+
+
 void close_window(SDL_Window *window, SDL_Renderer* renderer, SDL_Texture *texture) {
     SDL_DestroyWindow(window);
     SDL_DestroyRenderer(renderer);
@@ -3,13 +3,28 @@
 
 #include <SDL2/SDL.h>
 #include "chip8_t.h"
+#include "expand.h"
 
 #define WINDOW_HEIGHT 640
 #define WINDOW_WIDTH 1280
 
-void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **sdl_texture);
-void buffer_graphics(Chip8 *chip8, uint32_t *buffer, SDL_Renderer *renderer);
-void draw_graphics(uint32_t *buffer, SDL_Renderer *renderer, SDL_Texture *texture);
+// Tiles of the screens of many systems in one texture, see init_tile_atlas
+#define TILE_GAP 1                      // background pixels between tiles
+
+typedef struct {
+    SDL_Texture *texture;
+    int count;
+    int columns;
+    int rows;
+} TileAtlas;
+
+void init_window(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **sdl_texture, int vsync);
+Uint64 get_refresh_ticks(SDL_Window *window);
+void set_palette(Palette palette);
+void draw_graphics(Chip8 *chip8, SDL_Renderer *renderer, SDL_Texture *texture);
+int init_tile_atlas(SDL_Renderer *renderer, TileAtlas *atlas, int count);
+int draw_tiles(Chip8 *systems, int count, SDL_Renderer *renderer, TileAtlas *atlas);
+void close_tile_atlas(TileAtlas *atlas);
 void close_window(SDL_Window *window, SDL_Renderer* renderer, SDL_Texture *texture);
 
 #endif // SCREEN_H
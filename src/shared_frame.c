@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shared_frame.h"
+
+
+/*
+* Creates (or replaces) the shared memory segment with the given name,
+* e.g. "/chip8". Returns NULL if it could not be created
+*/
+SharedFrame *create_shared_frame(const char *name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("ERROR: Could not create shared memory");
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(SharedFrame)) != 0) {
+        perror("ERROR: Could not size shared memory");
+        close(fd);
+        return NULL;
+    }
+
+    SharedFrame *frame = mmap(NULL, sizeof(SharedFrame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (frame == MAP_FAILED) {
+        perror("ERROR: Could not map shared memory");
+        return NULL;
+    }
+
+    memset(frame, 0, sizeof(SharedFrame));
+    frame->magic = SHARED_FRAME_MAGIC;
+    frame->version = SHARED_FRAME_VERSION;
+    return frame;
+}
+
+
+// Copies the current screen and registers into the segment as the next frame
+void publish_shared_frame(SharedFrame *frame, Chip8 *chip8) {
+    uint32_t sequence = frame->sequence;
+
+    // Odd sequence: readers that see it (or see it change) retry
+    __atomic_store_n(&frame->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(frame->screen, chip8->screen, sizeof(frame->screen));
+    memcpy(frame->V, chip8->V, sizeof(frame->V));
+    frame->I_reg = chip8->I_reg;
+    frame->pc_reg = chip8->pc_reg;
+    frame->sp_reg = chip8->sp_reg;
+    frame->delay_timer = chip8->delay_timer;
+    frame->sound_timer = chip8->sound_timer;
+    frame->frame_number++;
+
+    __atomic_store_n(&frame->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+void destroy_shared_frame(SharedFrame *frame, const char *name) {
+    munmap(frame, sizeof(SharedFrame));
+    shm_unlink(name);
+}
+
+
+// Maps an existing segment read only, returns NULL if it does not exist or is from another version
+const SharedFrame *attach_shared_frame(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    const SharedFrame *frame = mmap(NULL, sizeof(SharedFrame), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (frame == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (frame->magic != SHARED_FRAME_MAGIC || frame->version != SHARED_FRAME_VERSION) {
+        munmap((void *) frame, sizeof(SharedFrame));
+        return NULL;
+    }
+    return frame;
+}
+
+
+// Takes a consistent copy of the latest frame
+void copy_shared_frame(const SharedFrame *frame, SharedFrame *copy) {
+    uint32_t sequence;
+    do {
+        sequence = shared_frame_read_begin(frame);
+        memcpy(copy, frame, sizeof(SharedFrame));
+    } while (shared_frame_read_retry(frame, sequence));
+}
+
+
+void detach_shared_frame(const SharedFrame *frame) {
+    munmap((void *) frame, sizeof(SharedFrame));
+}
@@ -0,0 +1,72 @@
+#ifndef SHARED_FRAME_H
+#define SHARED_FRAME_H
+
+#include <stdint.h>
+#include "chip8_t.h"
+
+/*
+*
+* Screen and register export through POSIX shared memory.
+*
+* The emulator publishes into the segment once per frame, guarded by a
+* sequence lock: the sequence is odd while a frame is being written. Readers
+* never block the emulator, they read the fields in place between
+* shared_frame_read_begin and shared_frame_read_retry and start over if
+* the frame changed underneath them, so they never act on a torn frame.
+*
+*   const SharedFrame *frame = attach_shared_frame("/chip8");
+*   uint32_t sequence;
+*   do {
+*       sequence = shared_frame_read_begin(frame);
+*       ... read frame->screen, frame->V ...
+*   } while (shared_frame_read_retry(frame, sequence));
+*
+*/
+
+#define SHARED_FRAME_MAGIC 0x46533843       // "C8SF"
+#define SHARED_FRAME_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;                      // odd while the emulator is writing
+    uint32_t frame_number;                  // frames published so far
+
+    uint8_t screen[SCREEN_HEIGHT][SCREEN_WIDTH];
+    uint8_t V[NUM_V_REGISTERS];
+    uint16_t I_reg;
+    uint16_t pc_reg;
+    uint16_t sp_reg;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+} SharedFrame;
+
+
+// Waits for the writer to finish (it never holds the lock for more than one copy)
+static inline uint32_t shared_frame_read_begin(const SharedFrame *frame) {
+    uint32_t sequence;
+    do {
+        sequence = __atomic_load_n(&frame->sequence, __ATOMIC_ACQUIRE);
+    } while (sequence & 1);
+    return sequence;
+}
+
+// TRUE if a new frame was published while reading, the read has to be repeated
+static inline int shared_frame_read_retry(const SharedFrame *frame, uint32_t sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&frame->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+
+// Emulator side
+SharedFrame *create_shared_frame(const char *name);
+void publish_shared_frame(SharedFrame *frame, Chip8 *chip8);
+void destroy_shared_frame(SharedFrame *frame, const char *name);
+
+// Reader side
+const SharedFrame *attach_shared_frame(const char *name);
+void copy_shared_frame(const SharedFrame *frame, SharedFrame *copy);
+void detach_shared_frame(const SharedFrame *frame);
+
+
+#endif // SHARED_FRAME_H
@@ -0,0 +1,52 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include "chip8_t.h"
+
+/*
+*
+* Zobrist style hashes of ram and the screen, kept up to date in
+* chip8->ram_hash and chip8->screen_hash by every write to them.
+*
+* Every ram byte contributes a key for its address and value (a 0 byte
+* contributes nothing) and every pixel that is on a key for its position,
+* combined with XOR. A write only needs the keys of the old and the new
+* value, a pixel flip only the key of the pixel. The keys come from the
+* splitmix64 finalizer. Ram keys are computed on each write, a table of
+* every address and value would be 8 MB. A DXYN flips up to 120 pixels,
+* so the 2048 pixel keys are looked up in PIXEL_KEYS, which the compiler
+* fills in from MIX_KEY.
+*
+*/
+
+#define MIX_ADD(x) ((x) + 0x9E3779B97F4A7C15ULL)
+#define MIX_SHIFT_30(x) (((x) ^ ((x) >> 30)) * 0xBF58476D1CE4E5B9ULL)
+#define MIX_SHIFT_27(x) (((x) ^ ((x) >> 27)) * 0x94D049BB133111EBULL)
+#define MIX_SHIFT_31(x) ((x) ^ ((x) >> 31))
+
+// The splitmix64 finalizer as a constant expression, for tables
+#define MIX_KEY(x) MIX_SHIFT_31(MIX_SHIFT_27(MIX_SHIFT_30(MIX_ADD((uint64_t)(x)))))
+
+// Pixel keys are taken from above the ram keys (address << 8 | value < 1 << 20)
+#define PIXEL_KEY(index) MIX_KEY(((uint64_t)1 << 20) + (index))
+
+// PIXEL_KEY of every pixel, defined in chip8.c
+extern const uint64_t PIXEL_KEYS[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+
+static inline uint64_t mix_key(uint64_t x) {
+    return MIX_KEY(x);
+}
+
+
+static inline uint64_t ram_key(uint16_t address, uint8_t value) {
+    return value != 0 ? mix_key((uint64_t)address << 8 | value) : 0;
+}
+
+
+static inline uint64_t pixel_key(unsigned index) {
+    return PIXEL_KEYS[index];
+}
+
+
+#endif // STATE_HASH_H
@@ -0,0 +1,56 @@
+#include <string.h>
+#include "timing.h"
+#include "api.h"
+
+
+const TimingProfile TIMING_FIXED = {
+    "fixed", CYCLES_PER_FRAME, FALSE,
+    {
+        [OP_CLS] = 1, [OP_RET] = 1, [OP_JP] = 1, [OP_CALL] = 1,
+        [OP_SE_VX_KK] = 1, [OP_SNE_VX_KK] = 1, [OP_SE_VX_VY] = 1, [OP_LD_VX_KK] = 1,
+        [OP_ADD_VX_KK] = 1, [OP_LD_VX_VY] = 1, [OP_OR_VX_VY] = 1, [OP_AND_VX_VY] = 1,
+        [OP_XOR_VX_VY] = 1, [OP_ADD_VX_VY] = 1, [OP_SUB_VX_VY] = 1, [OP_SHR_VX] = 1,
+        [OP_SUBN_VX_VY] = 1, [OP_SHL_VX] = 1, [OP_SNE_VX_VY] = 1, [OP_LD_I] = 1,
+        [OP_JP_V0] = 1, [OP_RND] = 1, [OP_DRW] = 1, [OP_SKP] = 1,
+        [OP_SKNP] = 1, [OP_LD_VX_DT] = 1, [OP_LD_VX_K] = 1, [OP_LD_DT_VX] = 1,
+        [OP_LD_ST_VX] = 1, [OP_ADD_I_VX] = 1, [OP_LD_F_VX] = 1, [OP_LD_B_VX] = 1,
+        [OP_ST_V_REGS] = 1, [OP_LD_V_REGS] = 1, [OP_INVALID] = 1,
+    }
+};
+
+
+/*
+* Approximate times in microseconds for the VIP interpreter, fetch and
+* decode included. The real times depend on the operands (sprite size and
+* position, number of registers, skip taken or not), these are typical
+* values. About a quarter of every frame goes to the display interrupt
+* and DMA, the rest is the budget.
+*/
+const TimingProfile TIMING_VIP = {
+    "vip", 12500, TRUE,
+    {
+        [OP_CLS] = 109, [OP_RET] = 105, [OP_JP] = 105, [OP_CALL] = 105,
+        [OP_SE_VX_KK] = 55, [OP_SNE_VX_KK] = 55, [OP_SE_VX_VY] = 73, [OP_LD_VX_KK] = 27,
+        [OP_ADD_VX_KK] = 45, [OP_LD_VX_VY] = 200, [OP_OR_VX_VY] = 200, [OP_AND_VX_VY] = 200,
+        [OP_XOR_VX_VY] = 200, [OP_ADD_VX_VY] = 200, [OP_SUB_VX_VY] = 200, [OP_SHR_VX] = 200,
+        [OP_SUBN_VX_VY] = 200, [OP_SHL_VX] = 200, [OP_SNE_VX_VY] = 73, [OP_LD_I] = 55,
+        [OP_JP_V0] = 105, [OP_RND] = 164, [OP_DRW] = 3812, [OP_SKP] = 73,
+        [OP_SKNP] = 73, [OP_LD_VX_DT] = 45, [OP_LD_VX_K] = 45, [OP_LD_DT_VX] = 45,
+        [OP_LD_ST_VX] = 45, [OP_ADD_I_VX] = 86, [OP_LD_F_VX] = 91, [OP_LD_B_VX] = 927,
+        [OP_ST_V_REGS] = 605, [OP_LD_V_REGS] = 605, [OP_INVALID] = 1,
+    }
+};
+
+
+static const TimingProfile *const TIMING_PROFILES[] = {&TIMING_FIXED, &TIMING_VIP};
+
+
+// Looks up a timing profile by name, returns NULL if there is no such profile
+const TimingProfile *find_timing_profile(const char *name) {
+    for (size_t i = 0; i < sizeof(TIMING_PROFILES) / sizeof(TIMING_PROFILES[0]); i++) {
+        if (strcmp(name, TIMING_PROFILES[i]->name) == 0) {
+            return TIMING_PROFILES[i];
+        }
+    }
+    return NULL;
+}
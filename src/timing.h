@@ -0,0 +1,35 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "decode.h"
+
+/*
+*
+* Cycle costs of the instructions, used by the frontend to decide how many
+* instructions run in each 60 Hz frame. Every frame gets frame_cycles to
+* spend, an instruction that overruns the budget is paid back from the
+* next frame.
+*
+* The fixed profile costs 1 per instruction with a budget of
+* CYCLES_PER_FRAME, the speed the emulator always ran at. The vip profile
+* approximates the COSMAC VIP interpreter in microseconds, so drawing is
+* slow and register arithmetic is fast like on the original hardware.
+*
+*/
+
+#define FRAMES_PER_SECOND 60
+
+typedef struct {
+    const char *name;
+    uint32_t frame_cycles;              // cycles to spend in every frame
+    uint8_t display_wait;               // DXYN ends the frame, it waits for the next vblank
+    uint16_t costs[OPCODE_COUNT];       // cycles per instruction
+} TimingProfile;
+
+extern const TimingProfile TIMING_FIXED;
+extern const TimingProfile TIMING_VIP;
+
+const TimingProfile *find_timing_profile(const char *name);
+
+
+#endif // TIMING_H
@@ -0,0 +1,140 @@
+#include <string.h>
+#include "video.h"
+
+// Longest encoded frame: the gap and every byte as a literal with a run byte per 128
+#define MAX_ENCODED_FRAME (5 + VIDEO_FRAME_SIZE + VIDEO_FRAME_SIZE / VIDEO_MAX_RUN)
+
+
+// Opens a recording for writing, returns FALSE if the file can not be created
+int open_video_writer(VideoWriter *writer, const char *path) {
+    memset(writer, 0, sizeof(VideoWriter));
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return FALSE;
+    }
+
+    uint8_t header[8] = {'C', '8', 'V', '1', SCREEN_WIDTH & 0xFF, SCREEN_WIDTH >> 8,
+                         SCREEN_HEIGHT & 0xFF, SCREEN_HEIGHT >> 8};
+    writer->bytes = fwrite(header, 1, sizeof(header), writer->file);
+    return writer->bytes == sizeof(header);
+}
+
+
+/*
+* Appends a packed frame (VIDEO_FRAME_SIZE bytes) shown at the given 60 Hz
+* frame number, frame numbers only go up. Returns FALSE if the write failed
+*/
+int write_video_frame(VideoWriter *writer, const uint8_t *packed, uint32_t frame_number) {
+    uint8_t data[MAX_ENCODED_FRAME];
+    size_t size = 0;
+
+    uint32_t gap = writer->frames > 0 ? frame_number - writer->previous_frame : 0;
+    do {
+        data[size++] = (gap & 0x7F) | (gap > 0x7F ? 0x80 : 0);
+        gap >>= 7;
+    } while (gap > 0);
+
+    int i = 0;
+    while (i < VIDEO_FRAME_SIZE) {
+        // Unchanged bytes are skipped, a single one between changes is cheaper as part of the literal
+        int run = 0;
+        while (i + run < VIDEO_FRAME_SIZE && run < VIDEO_MAX_RUN && packed[i + run] == writer->previous[i + run]) {
+            run++;
+        }
+        if (run > 1 || (run == 1 && i + 1 == VIDEO_FRAME_SIZE)) {
+            data[size++] = run - 1;
+            i += run;
+            continue;
+        }
+
+        run = 1;
+        while (i + run < VIDEO_FRAME_SIZE && run < VIDEO_MAX_RUN &&
+               (packed[i + run] != writer->previous[i + run] ||
+                (i + run + 1 < VIDEO_FRAME_SIZE && packed[i + run + 1] != writer->previous[i + run + 1]))) {
+            run++;
+        }
+        data[size++] = 0x80 | (run - 1);
+        memcpy(&data[size], &packed[i], run);
+        size += run;
+        i += run;
+    }
+
+    memcpy(writer->previous, packed, VIDEO_FRAME_SIZE);
+    writer->previous_frame = frame_number;
+    writer->frames++;
+    writer->bytes += size;
+    return fwrite(data, 1, size, writer->file) == size;
+}
+
+
+// Closes the recording, returns FALSE if the data could not be written out
+int close_video_writer(VideoWriter *writer) {
+    return fclose(writer->file) == 0;
+}
+
+
+// Opens a recording for reading, returns FALSE if it is missing or not a recording of this screen size
+int open_video_reader(VideoReader *reader, const char *path) {
+    uint8_t header[8];
+
+    memset(reader, 0, sizeof(VideoReader));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        return FALSE;
+    }
+
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, VIDEO_MAGIC, 4) != 0 ||
+        (header[4] | header[5] << 8) != SCREEN_WIDTH || (header[6] | header[7] << 8) != SCREEN_HEIGHT) {
+        fclose(reader->file);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/*
+* Reads the next frame into reader->screen. Returns TRUE if a frame was
+* read, FALSE at the end of the recording and -1 if the file is damaged
+*/
+int read_video_frame(VideoReader *reader) {
+    uint32_t gap = 0;
+    int byte;
+
+    for (int shift = 0; ; shift += 7) {
+        if ((byte = fgetc(reader->file)) == EOF) {
+            return shift == 0 ? FALSE : -1;
+        }
+        if (shift > 28) {
+            return -1;
+        }
+        gap |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {break;}
+    }
+
+    int i = 0;
+    while (i < VIDEO_FRAME_SIZE) {
+        if ((byte = fgetc(reader->file)) == EOF) {
+            return -1;
+        }
+
+        int run = (byte & 0x7F) + 1;
+        if (i + run > VIDEO_FRAME_SIZE) {
+            return -1;
+        }
+        if ((byte & 0x80) && fread(&reader->screen[i], 1, run, reader->file) != (size_t)run) {
+            return -1;
+        }
+        i += run;
+    }
+
+    reader->frame_number += gap;
+    reader->frames++;
+    return TRUE;
+}
+
+
+void close_video_reader(VideoReader *reader) {
+    fclose(reader->file);
+}
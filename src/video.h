@@ -0,0 +1,57 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "chip8_t.h"
+
+/*
+*
+* Lossless recordings of the screen (.c8v files).
+*
+* Frames are packed 1 bit per pixel, 8 pixels per byte with the leftmost
+* pixel in the MSb (the layout of chip8_get_screen_packed), and stored as
+* the change from the previous frame, so a frame that redrew a few sprites
+* costs a few bytes.
+*
+* File layout (little endian):
+*   "C8V1"      magic
+*   width       2 bytes
+*   height      2 bytes
+*   frames, each:
+*     gap       varint, 60 Hz frames since the previous recorded frame
+*     runs      until VIDEO_FRAME_SIZE bytes are covered:
+*                 0x00 - 0x7F  the next 1 - 128 bytes are unchanged
+*                 0x80 - 0xFF  the next 1 - 128 bytes follow as they are
+*
+*/
+
+#define VIDEO_MAGIC "C8V1"
+#define VIDEO_FRAME_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
+#define VIDEO_MAX_RUN 128
+
+typedef struct {
+    FILE *file;
+    uint8_t previous[VIDEO_FRAME_SIZE];
+    uint32_t previous_frame;            // frame number of the last frame written
+    uint32_t frames;
+    uint64_t bytes;                     // size of the file so far
+} VideoWriter;
+
+typedef struct {
+    FILE *file;
+    uint8_t screen[VIDEO_FRAME_SIZE];   // the frame read last, packed
+    uint32_t frame_number;              // its 60 Hz frame, counted from the first frame
+    uint32_t frames;
+} VideoReader;
+
+int open_video_writer(VideoWriter *writer, const char *path);
+int write_video_frame(VideoWriter *writer, const uint8_t *packed, uint32_t frame_number);
+int close_video_writer(VideoWriter *writer);
+
+int open_video_reader(VideoReader *reader, const char *path);
+int read_video_frame(VideoReader *reader);
+void close_video_reader(VideoReader *reader);
+
+
+#endif // VIDEO_H
@@ -0,0 +1,261 @@
+/*
+* Chip8 Core Checks
+*
+* Checks of the parts of the core that golden frames do not cover, run by
+* make check after the golden frame run over the same test roms:
+*
+*   hash      ram_hash and screen_hash equal the hashes from scratch after
+*             every frame of every test rom and quirk profile, and the
+*             visited set finds the states of a run it has seen
+*   fork      a forked system and a fork of it run the same as a plain
+*             copy, and their writes stay out of the parent
+*   netplay   two sides on loopback, one running ahead of the other, end
+*             in the state a single system reaches with both sides' keys
+*   video     a .c8v recording reads back frame for frame, and a cut off
+*             one is reported as damaged
+*
+* Prints every failed check and exits with a failure status if there was
+* one. The netplay check needs UDP ports NETPLAY_PORT and NETPLAY_PORT + 1
+* on 127.0.0.1.
+*
+* Example: <unix> ./chip8-check
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "api.h"
+#include "netplay.h"
+#include "quirks.h"
+#include "video.h"
+#include "test_roms.h"
+
+#define HASH_FRAMES 120
+#define FORK_FRAMES 60
+#define NETPLAY_PORT 47610
+#define NETPLAY_FRAMES 300
+#define VIDEO_PATH "chip8-check.c8v"
+#define VIDEO_FRAMES 8
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static const uint8_t PROFILES[] = {QUIRKS_LEGACY, QUIRKS_VIP, QUIRKS_SCHIP, QUIRKS_XOCHIP};
+#define PROFILE_COUNT (sizeof(PROFILES) / sizeof(PROFILES[0]))
+
+static int checks;
+static int failures;
+
+
+// Returns passed, so a check can stop a loop after its first failure
+static int check(int passed, const char *condition, int line) {
+    checks++;
+    if (!passed) {
+        printf("FAIL   line %i: %s\n", line, condition);
+        failures++;
+    }
+    return passed;
+}
+
+
+// Keys that keep keys.ch8 busy: key (frame / 8) % 16 held for 5 frames of every 8
+static uint16_t test_keys(int frame) {
+    return frame % 8 < 5 ? 1 << (frame / 8 % 16) : 0;
+}
+
+
+static void check_hashes(void) {
+    static Chip8 chip8;
+
+    for (size_t rom = 0; rom < TEST_ROM_COUNT; rom++) {
+        for (size_t profile = 0; profile < PROFILE_COUNT; profile++) {
+            chip8_load(&chip8, TEST_ROMS[rom].data, TEST_ROMS[rom].length);
+            chip8.quirks = PROFILES[profile];
+
+            for (int frame = 0; frame < HASH_FRAMES; frame++) {
+                chip8_set_keys(&chip8, test_keys(frame));
+                chip8_step_frames(&chip8, 1, NULL, NULL);
+                if (!CHECK(chip8.ram_hash == compute_ram_hash(&chip8)) ||
+                    !CHECK(chip8.screen_hash == compute_screen_hash(&chip8))) {
+                    printf("       %s, profile %s, frame %i\n", TEST_ROMS[rom].name,
+                           quirk_profile_name(PROFILES[profile]), frame);
+                    break;
+                }
+            }
+        }
+    }
+
+    // A second run through the same states finds every one of them, the set starts small to grow
+    Chip8VisitedSet set;
+    size_t states = 0;
+    CHECK(chip8_visited_init(&set, 4));
+    for (int run = 0; run < 2; run++) {
+        chip8_load(&chip8, SPRITES_ROM, sizeof(SPRITES_ROM));
+        for (int frame = 0; frame < HASH_FRAMES; frame++) {
+            chip8_step_frames(&chip8, 1, NULL, NULL);
+            int inserted = chip8_visited_insert(&set, chip8_state_hash(&chip8));
+            if (run == 0) {
+                states += inserted == TRUE;
+            }
+            else if (!CHECK(inserted == FALSE)) {
+                break;
+            }
+        }
+    }
+    CHECK(states > 1 && set.count == states);
+    chip8_visited_free(&set);
+}
+
+
+static int same_ram(const Chip8 *a, const Chip8 *b) {
+    for (int i = 0; i < TOTAL_RAM; i++) {
+        if (chip8_read_ram(a, i) != chip8_read_ram(b, i)) {return FALSE;}
+    }
+    return TRUE;
+}
+
+
+static void check_fork(void) {
+    static Chip8 parent, child, grandchild, copy, before;
+
+    // alu.ch8 writes its digits with FX33 throughout, part way through it some results are still to come
+    chip8_load(&parent, ALU_ROM, sizeof(ALU_ROM));
+    chip8_step_frames(&parent, 3, NULL, NULL);
+    copy = parent;
+    before = parent;
+
+    chip8_fork(&parent, &child);
+    CHECK(chip8_state_hash(&child) == chip8_state_hash(&copy) && same_ram(&child, &copy));
+
+    chip8_step_frames(&child, FORK_FRAMES, NULL, NULL);
+    chip8_step_frames(&copy, FORK_FRAMES, NULL, NULL);
+    CHECK(chip8_state_hash(&child) == chip8_state_hash(&copy) && same_ram(&child, &copy));
+    CHECK(chip8_state_hash(&parent) == chip8_state_hash(&before) && same_ram(&parent, &before));
+
+    chip8_fork(&child, &grandchild);
+    chip8_step_frames(&grandchild, FORK_FRAMES, NULL, NULL);
+    chip8_step_frames(&copy, FORK_FRAMES, NULL, NULL);
+    CHECK(chip8_state_hash(&grandchild) == chip8_state_hash(&copy) && same_ram(&grandchild, &copy));
+    CHECK(chip8_state_hash(&parent) == chip8_state_hash(&before) && same_ram(&parent, &before));
+}
+
+
+// Side 0 presses key 2 and side 1 key 7, at different times, on keys.ch8
+static uint16_t netplay_keys(int side, uint32_t frame) {
+    if (side == 0) {
+        return frame % 12 < 4 ? 1 << 2 : 0;
+    }
+    return frame % 12 >= 6 && frame % 12 < 9 ? 1 << 7 : 0;
+}
+
+
+static void check_netplay(void) {
+    static Netplay sides[2];
+    static Chip8 systems[2];
+    static Chip8 reference;
+
+    if (!CHECK(init_netplay(&sides[0], NETPLAY_PORT, "127.0.0.1", NETPLAY_PORT + 1))) {
+        return;
+    }
+    if (!CHECK(init_netplay(&sides[1], NETPLAY_PORT + 1, "127.0.0.1", NETPLAY_PORT))) {
+        close_netplay(&sides[0]);
+        return;
+    }
+
+    // Side 0 runs twice as many frames per turn, it predicts side 1's keys and gets far enough ahead to wait
+    for (int side = 0; side < 2; side++) {
+        chip8_load(&systems[side], KEYS_ROM, sizeof(KEYS_ROM));
+    }
+    while (sides[0].frame < NETPLAY_FRAMES || sides[1].frame < NETPLAY_FRAMES) {
+        for (int side = 0; side < 2; side++) {
+            for (int i = 0; i < (side == 0 ? 6 : 3) && sides[side].frame < NETPLAY_FRAMES; i++) {
+                netplay_advance(&sides[side], &systems[side], netplay_keys(side, sides[side].frame));
+            }
+        }
+    }
+    for (int i = 0; i < 100 && (sides[0].remote_confirmed < NETPLAY_FRAMES ||
+                                sides[1].remote_confirmed < NETPLAY_FRAMES); i++) {
+        poll_netplay(&sides[0], &systems[0]);
+        poll_netplay(&sides[1], &systems[1]);
+    }
+
+    chip8_load(&reference, KEYS_ROM, sizeof(KEYS_ROM));
+    for (uint32_t frame = 0; frame < NETPLAY_FRAMES; frame++) {
+        chip8_set_keys(&reference, netplay_keys(0, frame) | netplay_keys(1, frame));
+        chip8_step_frames(&reference, 1, NULL, NULL);
+    }
+
+    CHECK(sides[0].remote_confirmed == NETPLAY_FRAMES && sides[1].remote_confirmed == NETPLAY_FRAMES);
+    CHECK(sides[0].rollbacks > 0 && sides[0].stalls > 0);
+    CHECK(chip8_state_hash(&systems[0]) == chip8_state_hash(&reference));
+    CHECK(chip8_state_hash(&systems[1]) == chip8_state_hash(&reference));
+    close_netplay(&sides[0]);
+    close_netplay(&sides[1]);
+}
+
+
+static void check_video(void) {
+    static uint8_t frames[VIDEO_FRAMES][VIDEO_FRAME_SIZE];
+    static const uint32_t FRAME_NUMBERS[VIDEO_FRAMES] = {7, 8, 9, 200, 20000, 20001, 20002, 20003};
+    static Chip8 chip8;
+
+    // Literal and unchanged runs longer than VIDEO_MAX_RUN, single changed bytes, then screens of a rom
+    memset(frames[1], 0xFF, VIDEO_FRAME_SIZE);
+    memset(frames[2], 0xFF, VIDEO_FRAME_SIZE);
+    memset(frames[3], 0xFF, VIDEO_FRAME_SIZE);
+    frames[3][0] = frames[3][2] = frames[3][VIDEO_FRAME_SIZE - 1] = 0x5A;
+    chip8_load(&chip8, SPRITES_ROM, sizeof(SPRITES_ROM));
+    for (int i = 4; i < VIDEO_FRAMES; i++) {
+        chip8_step_frames(&chip8, 2, NULL, NULL);
+        chip8_get_screen_packed(&chip8, frames[i]);
+    }
+
+    VideoWriter writer;
+    if (!CHECK(open_video_writer(&writer, VIDEO_PATH))) {
+        return;
+    }
+    for (int i = 0; i < VIDEO_FRAMES; i++) {
+        CHECK(write_video_frame(&writer, frames[i], FRAME_NUMBERS[i]));
+    }
+    CHECK(close_video_writer(&writer));
+
+    VideoReader reader;
+    if (CHECK(open_video_reader(&reader, VIDEO_PATH))) {
+        for (int i = 0; i < VIDEO_FRAMES; i++) {
+            if (!CHECK(read_video_frame(&reader) == TRUE) ||
+                !CHECK(memcmp(reader.screen, frames[i], VIDEO_FRAME_SIZE) == 0) ||
+                !CHECK(reader.frame_number == FRAME_NUMBERS[i] - FRAME_NUMBERS[0])) {
+                printf("       frame %i\n", i);
+                break;
+            }
+        }
+        CHECK(read_video_frame(&reader) == FALSE);
+        close_video_reader(&reader);
+    }
+
+    // Without its last byte the last frame is damaged, the ones before it still read
+    CHECK(truncate(VIDEO_PATH, writer.bytes - 1) == 0);
+    if (CHECK(open_video_reader(&reader, VIDEO_PATH))) {
+        int frames_read = 0;
+        int result;
+        while ((result = read_video_frame(&reader)) == TRUE) {
+            frames_read++;
+        }
+        CHECK(result == -1 && frames_read == VIDEO_FRAMES - 1);
+        close_video_reader(&reader);
+    }
+    remove(VIDEO_PATH);
+}
+
+
+int main(void) {
+    check_hashes();
+    check_fork();
+    check_netplay();
+    check_video();
+
+    printf("%i checks, %i failed\n", checks, failures);
+    return failures > 0 ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,37 @@
+/*
+* Chip8 Test Rom Writer
+*
+* Writes the hand assembled test roms of test_roms.h as .ch8 files into a
+* directory, where tests/manifest.txt expects them. make regress and
+* make check run it first.
+*
+* Example: <unix> ./chip8-test-roms tests/
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "test_roms.h"
+
+#define MAX_PATH 512
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Program Usage: ./chip8-test-roms path/to/directory/\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < TEST_ROM_COUNT; i++) {
+        const TestRom *rom = &TEST_ROMS[i];
+        char path[MAX_PATH];
+        snprintf(path, sizeof(path), "%s%s", argv[1], rom->name);
+
+        FILE *file = fopen(path, "wb");
+        if (file == NULL || fwrite(rom->data, 1, rom->length, file) != rom->length) {
+            printf("ERROR: Could not write %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+#ifndef TEST_ROMS_H
+#define TEST_ROMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+*
+* Test roms, assembled by hand. Each line is an instruction (or data) with
+* its address and mnemonic, the mnemonics are Cowgod's. They only use the
+* built in font, and all of them end in an endless loop so they can run
+* for any number of frames.
+*
+*/
+
+typedef struct {
+    const char *name;
+    const uint8_t *data;
+    size_t length;
+} TestRom;
+
+/*
+* alu.ch8: the 8XY_ arithmetic on 200 and 100, each result printed with
+* FX33 as three digits followed by V[F]. QUIRK_VF_RESET and QUIRK_SHIFT_VY
+* change the OR and shift lines
+*/
+static const uint8_t ALU_ROM[] = {
+    0x66, 0x00,              // 200  LD V6, 0         x of the next result
+    0x67, 0x00,              // 202  LD V7, 0         y of the next result
+    0x63, 0xC8,              // 204  LD V3, 0xC8      200
+    0x64, 0x64,              // 206  LD V4, 0x64      100
+    0x65, 0x0B,              // 208  LD V5, 0x0B      11, shifted instead of V0 with QUIRK_SHIFT_VY
+    0x80, 0x30,              // 20A  LD V0, V3
+    0x80, 0x44,              // 20C  ADD V0, V4       44, carry
+    0x22, 0x50,              // 20E  CALL show
+    0x80, 0x40,              // 210  LD V0, V4
+    0x80, 0x35,              // 212  SUB V0, V3       156, borrow
+    0x22, 0x50,              // 214  CALL show
+    0x80, 0x40,              // 216  LD V0, V4
+    0x80, 0x37,              // 218  SUBN V0, V3      100, no borrow
+    0x22, 0x50,              // 21A  CALL show
+    0x80, 0x30,              // 21C  LD V0, V3
+    0x80, 0x56,              // 21E  SHR V0, V5       100 or 5
+    0x22, 0x50,              // 220  CALL show
+    0x80, 0x30,              // 222  LD V0, V3
+    0x80, 0x5E,              // 224  SHL V0, V5       144 or 22
+    0x22, 0x50,              // 226  CALL show
+    0x6F, 0x07,              // 228  LD VF, 7
+    0x80, 0x30,              // 22A  LD V0, V3
+    0x80, 0x41,              // 22C  OR V0, V4        236, V[F] kept or reset
+    0x22, 0x50,              // 22E  CALL show
+    0x6F, 0x09,              // 230  LD VF, 9
+    0x80, 0x30,              // 232  LD V0, V3
+    0x80, 0x42,              // 234  AND V0, V4       64
+    0x22, 0x50,              // 236  CALL show
+    0x6F, 0x03,              // 238  LD VF, 3
+    0x80, 0x30,              // 23A  LD V0, V3
+    0x80, 0x43,              // 23C  XOR V0, V4       172
+    0x22, 0x50,              // 23E  CALL show
+    0x60, 0x0F,              // 240  LD V0, 0x0F
+    0x80, 0x44,              // 242  ADD V0, V4       115, no carry
+    0x22, 0x50,              // 244  CALL show
+    0x6F, 0x05,              // 246  LD VF, 5
+    0x80, 0x30,              // 248  LD V0, V3
+    0x70, 0x64,              // 24A  ADD V0, 0x64     44, 7XKK leaves V[F] alone
+    0x22, 0x50,              // 24C  CALL show
+    // end:
+    0x12, 0x4E,              // 24E  JP end
+    // show:
+    0x88, 0xF0,              // 250  LD V8, VF        V[F] before DXYN overwrites it
+    0xA2, 0x7A,              // 252  LD I, digits
+    0xF0, 0x33,              // 254  LD B, V0
+    0xF2, 0x65,              // 256  LD V2, [I]       V0 - V2 = hundreds, tens, ones
+    0xF0, 0x29,              // 258  LD F, V0
+    0xD6, 0x75,              // 25A  DRW V6, V7, 5
+    0x76, 0x05,              // 25C  ADD V6, 5
+    0xF1, 0x29,              // 25E  LD F, V1
+    0xD6, 0x75,              // 260  DRW V6, V7, 5
+    0x76, 0x05,              // 262  ADD V6, 5
+    0xF2, 0x29,              // 264  LD F, V2
+    0xD6, 0x75,              // 266  DRW V6, V7, 5
+    0x76, 0x06,              // 268  ADD V6, 6
+    0xF8, 0x29,              // 26A  LD F, V8
+    0xD6, 0x75,              // 26C  DRW V6, V7, 5
+    0x76, 0x10,              // 26E  ADD V6, 16
+    0x36, 0x40,              // 270  SE V6, 64        two results per line
+    0x00, 0xEE,              // 272  RET
+    0x66, 0x00,              // 274  LD V6, 0
+    0x77, 0x06,              // 276  ADD V7, 6
+    0x00, 0xEE,              // 278  RET
+    // digits:
+    0x00, 0x00, 0x00,        // 27A  data
+};
+
+/*
+* sprites.ch8: boxes drawn across the screen edges, clipped with
+* QUIRK_CLIP and wrapped around otherwise, two overlapping ones with their
+* collision flags printed, and a dot moving right one pixel per frame off
+* the edge, paced by the delay timer
+*/
+static const uint8_t SPRITES_ROM[] = {
+    0x00, 0xE0,              // 200  CLS
+    0xA2, 0x50,              // 202  LD I, box
+    0x60, 0x3C,              // 204  LD V0, 60
+    0x61, 0x1C,              // 206  LD V1, 28
+    0xD0, 0x18,              // 208  DRW V0, V1, 8    corner, clipped or wrapped into all four corners
+    0x60, 0x7C,              // 20A  LD V0, 0x7C      124 starts at 60 after wrapping
+    0x61, 0x02,              // 20C  LD V1, 2
+    0xD0, 0x18,              // 20E  DRW V0, V1, 8
+    0x60, 0x14,              // 210  LD V0, 20
+    0x61, 0x0A,              // 212  LD V1, 10
+    0xD0, 0x18,              // 214  DRW V0, V1, 8
+    0x60, 0x18,              // 216  LD V0, 24
+    0x61, 0x0E,              // 218  LD V1, 14
+    0xD0, 0x18,              // 21A  DRW V0, V1, 8    overlaps the last box
+    0x85, 0xF0,              // 21C  LD V5, VF        collision: 1
+    0x60, 0x28,              // 21E  LD V0, 40
+    0x61, 0x04,              // 220  LD V1, 4
+    0xD0, 0x18,              // 222  DRW V0, V1, 8    clear of everything
+    0x86, 0xF0,              // 224  LD V6, VF        collision: 0
+    0x60, 0x28,              // 226  LD V0, 40
+    0x61, 0x14,              // 228  LD V1, 20
+    0xF5, 0x29,              // 22A  LD F, V5
+    0xD0, 0x15,              // 22C  DRW V0, V1, 5
+    0x60, 0x2E,              // 22E  LD V0, 46
+    0xF6, 0x29,              // 230  LD F, V6
+    0xD0, 0x15,              // 232  DRW V0, V1, 5
+    0x67, 0x34,              // 234  LD V7, 52        dot moving right off the edge, one pixel per frame
+    0x68, 0x16,              // 236  LD V8, 22
+    0xA2, 0x58,              // 238  LD I, dot
+    0xD7, 0x83,              // 23A  DRW V7, V8, 3
+    // loop:
+    0x63, 0x01,              // 23C  LD V3, 1
+    0xF3, 0x15,              // 23E  LD DT, V3
+    // wait:
+    0xF4, 0x07,              // 240  LD V4, DT
+    0x34, 0x00,              // 242  SE V4, 0
+    0x12, 0x40,              // 244  JP wait
+    0xA2, 0x58,              // 246  LD I, dot
+    0xD7, 0x83,              // 248  DRW V7, V8, 3
+    0x77, 0x01,              // 24A  ADD V7, 1
+    0xD7, 0x83,              // 24C  DRW V7, V8, 3
+    0x12, 0x3C,              // 24E  JP loop
+    // box:
+    0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF, // 250  data
+    // dot:
+    0xE0, 0xA0, 0xE0,        // 258  data
+};
+
+/*
+* keys.ch8: waits for a key with FX0A, prints it and waits for it to be
+* let go (EX9E) before reading the next one. Run with keys.mov
+*/
+static const uint8_t KEYS_ROM[] = {
+    0x66, 0x00,              // 200  LD V6, 0
+    0x67, 0x00,              // 202  LD V7, 0
+    // next:
+    0xF0, 0x0A,              // 204  LD V0, K         the highest key held
+    0xF0, 0x29,              // 206  LD F, V0
+    0xD6, 0x75,              // 208  DRW V6, V7, 5
+    0x76, 0x05,              // 20A  ADD V6, 5
+    0x36, 0x3C,              // 20C  SE V6, 60        12 keys per line
+    0x12, 0x14,              // 20E  JP release
+    0x66, 0x00,              // 210  LD V6, 0
+    0x77, 0x06,              // 212  ADD V7, 6
+    // release:
+    0xE0, 0x9E,              // 214  SKP V0           wait for the key to be let go
+    0x12, 0x04,              // 216  JP next
+    0x12, 0x14,              // 218  JP release
+};
+
+/*
+* memory.ch8: FX55 twice in a row (QUIRK_INCREMENT_I), BXNN
+* (QUIRK_JUMP_VX), three nested calls, FX65 and FX33 into a table and eight
+* random digits from CXKK
+*/
+static const uint8_t MEMORY_ROM[] = {
+    0x60, 0x01,              // 200  LD V0, 1
+    0x61, 0x02,              // 202  LD V1, 2
+    0x62, 0x03,              // 204  LD V2, 3
+    0x63, 0x04,              // 206  LD V3, 4
+    0xA2, 0x6E,              // 208  LD I, table
+    0xF3, 0x55,              // 20A  LD [I], V3       table[0..3], I moves to table + 4 with QUIRK_INCREMENT_I
+    0x60, 0x05,              // 20C  LD V0, 5
+    0xF0, 0x55,              // 20E  LD [I], V0       table[4] or table[0]
+    0x60, 0x00,              // 210  LD V0, 0
+    0x62, 0x04,              // 212  LD V2, 4
+    0xB2, 0x16,              // 214  JP V0, land      to land + V0, or land + V2 with QUIRK_JUMP_VX (X is 2)
+    // land:
+    0x69, 0x01,              // 216  LD V9, 1
+    0x12, 0x1C,              // 218  JP jumped
+    0x69, 0x02,              // 21A  LD V9, 2
+    // jumped:
+    0x6C, 0x00,              // 21C  LD VC, 0
+    0x22, 0x5E,              // 21E  CALL one         VC = 3 after three nested calls
+    0x66, 0x00,              // 220  LD V6, 0
+    0x67, 0x00,              // 222  LD V7, 0
+    0xA2, 0x6E,              // 224  LD I, table
+    0xF4, 0x65,              // 226  LD V4, [I]       table[0..4] back into V0 - V4
+    0x8A, 0x00,              // 228  LD VA, V0
+    0x8B, 0x40,              // 22A  LD VB, V4
+    0xFA, 0x29,              // 22C  LD F, VA
+    0xD6, 0x75,              // 22E  DRW V6, V7, 5
+    0x76, 0x05,              // 230  ADD V6, 5
+    0xFB, 0x29,              // 232  LD F, VB
+    0xD6, 0x75,              // 234  DRW V6, V7, 5
+    0x76, 0x05,              // 236  ADD V6, 5
+    0xF9, 0x29,              // 238  LD F, V9
+    0xD6, 0x75,              // 23A  DRW V6, V7, 5
+    0x76, 0x05,              // 23C  ADD V6, 5
+    0xFC, 0x29,              // 23E  LD F, VC
+    0xD6, 0x75,              // 240  DRW V6, V7, 5
+    0x6D, 0x08,              // 242  LD VD, 8         random digits, the generator is seeded the same every run
+    // random:
+    0xC6, 0x3F,              // 244  RND V6, 0x3F
+    0xC7, 0x1F,              // 246  RND V7, 0x1F
+    0xC0, 0x0F,              // 248  RND V0, 0x0F
+    0xF0, 0x29,              // 24A  LD F, V0
+    0xD6, 0x75,              // 24C  DRW V6, V7, 5
+    0x7D, 0xFF,              // 24E  ADD VD, 0xFF
+    0x3D, 0x00,              // 250  SE VD, 0
+    0x12, 0x44,              // 252  JP random
+    0x60, 0x03,              // 254  LD V0, 3
+    0xA2, 0x6E,              // 256  LD I, table
+    0xF0, 0x1E,              // 258  ADD I, V0        FX1E
+    0xFC, 0x33,              // 25A  LD B, VC         table[3..5] = 0, 0, 3
+    // end:
+    0x12, 0x5C,              // 25C  JP end
+    // one:
+    0x7C, 0x01,              // 25E  ADD VC, 1
+    0x22, 0x64,              // 260  CALL two
+    0x00, 0xEE,              // 262  RET
+    // two:
+    0x7C, 0x01,              // 264  ADD VC, 1
+    0x22, 0x6A,              // 266  CALL three
+    0x00, 0xEE,              // 268  RET
+    // three:
+    0x7C, 0x01,              // 26A  ADD VC, 1
+    0x00, 0xEE,              // 26C  RET
+    // table:
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 26E  data
+};
+
+/*
+* selfmod.ch8: FX55 writes over an instruction further on in the same
+* block, which then loads 0x55 instead of 0x11. The value is printed with
+* FX33 as three digits, 085 (017 if the old instruction ran)
+*/
+static const uint8_t SELFMOD_ROM[] = {
+    0x60, 0x62,              // 200  LD V0, 0x62
+    0x61, 0x55,              // 202  LD V1, 0x55
+    0xA2, 0x0A,              // 204  LD I, patch
+    0xF1, 0x55,              // 206  LD [I], V1       patch becomes 6255
+    0x63, 0x00,              // 208  LD V3, 0
+    // patch:
+    0x62, 0x11,              // 20A  LD V2, 0x11      runs as LD V2, 0x55
+    0xA2, 0x28,              // 20C  LD I, digits
+    0xF2, 0x33,              // 20E  LD B, V2
+    0xF2, 0x65,              // 210  LD V2, [I]       the digits into V0 - V2
+    0x6A, 0x00,              // 212  LD VA, 0
+    0x6B, 0x00,              // 214  LD VB, 0
+    0xF0, 0x29,              // 216  LD F, V0
+    0xDA, 0xB5,              // 218  DRW VA, VB, 5
+    0x7A, 0x05,              // 21A  ADD VA, 5
+    0xF1, 0x29,              // 21C  LD F, V1
+    0xDA, 0xB5,              // 21E  DRW VA, VB, 5
+    0x7A, 0x05,              // 220  ADD VA, 5
+    0xF2, 0x29,              // 222  LD F, V2
+    0xDA, 0xB5,              // 224  DRW VA, VB, 5
+    // end:
+    0x12, 0x26,              // 226  JP end
+    // digits:
+    0x00, 0x00, 0x00,        // 228  data
+};
+
+static const TestRom TEST_ROMS[] = {
+    {"alu.ch8", ALU_ROM, sizeof(ALU_ROM)},
+    {"sprites.ch8", SPRITES_ROM, sizeof(SPRITES_ROM)},
+    {"keys.ch8", KEYS_ROM, sizeof(KEYS_ROM)},
+    {"memory.ch8", MEMORY_ROM, sizeof(MEMORY_ROM)},
+    {"selfmod.ch8", SELFMOD_ROM, sizeof(SELFMOD_ROM)}
+};
+#define TEST_ROM_COUNT (sizeof(TEST_ROMS) / sizeof(TEST_ROMS[0]))
+
+
+#endif // TEST_ROMS_H
@@ -0,0 +1,187 @@
+/*
+* Chip8 Disassembler
+*
+* Disassembles a rom starting at 0x200, following the reachable code
+* through jumps, calls, skips and returns. Bytes that are never reached
+* are listed as data. Indirect jumps and stores that may write over code
+* are reported at the top of the listing. Stores are followed as they
+* behave under the quirk profile given (legacy by default).
+*
+* Example: <unix> ./chip8-dis rom_dir/rom_name [vip]
+*
+* To print the control flow graph in graphviz DOT format instead:
+*     <unix> ./chip8-dis rom_dir/rom_name dot [vip] | dot -Tsvg > rom.svg
+*/
+
+#include <string.h>
+#include "analyze.h"
+#include "quirks.h"
+
+#define DATA_BYTES_PER_LINE 8
+
+
+// Reads the rom into ram at PROGRAM_START_ADDR, returns the address after the last byte
+static uint16_t read_rom(const char *rom_filename, uint8_t *ram) {
+    FILE *rom = fopen(rom_filename, "rb");
+    if (rom == NULL) {
+        printf("ERROR: ROM file does not exist\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t rom_length = fread(ram + PROGRAM_START_ADDR, 1, PROGRAM_END_ADDR - PROGRAM_START_ADDR, rom);
+    if (fgetc(rom) != EOF) {
+        printf("ERROR: ROM file too large\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(rom);
+    return PROGRAM_START_ADDR + rom_length;
+}
+
+
+static uint16_t opcode_at(const uint8_t *ram, uint16_t address) {
+    return ram[address] << 8 | ram[address + 1];
+}
+
+
+static void print_block(const uint8_t *ram, const BasicBlock *block) {
+    char text[32];
+
+    printf("block_%03X:\n", block->start);
+    for (uint16_t address = block->start; address < block->end; address += 2) {
+        uint16_t opcode = opcode_at(ram, address);
+        format_instruction(opcode, text, sizeof(text));
+        printf("    %03X  %04X  %s\n", address, opcode, text);
+    }
+
+    if (block->successor_count > 0) {
+        printf("                ; ->");
+        for (int i = 0; i < block->successor_count; i++) {
+            printf(" block_%03X", block->successors[i]);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+
+// Prints a run of data bytes, returns the address after the run
+static int print_data(const uint8_t *ram, const RomAnalysis *analysis, int address) {
+    printf("data_%03X:\n", address);
+
+    while (address < analysis->rom_end && (analysis->flags[address] & (ADDR_CODE | ADDR_OPERAND)) == 0) {
+        printf("    %03X ", address);
+        for (int i = 0; i < DATA_BYTES_PER_LINE && address < analysis->rom_end &&
+                        (analysis->flags[address] & (ADDR_CODE | ADDR_OPERAND)) == 0; i++) {
+            printf(" %02X", ram[address++]);
+        }
+        printf("\n");
+    }
+    printf("\n");
+    return address;
+}
+
+
+static void print_listing(const uint8_t *ram, const RomAnalysis *analysis, const char *rom_filename) {
+    char text[32];
+
+    printf("; %s: %i bytes, %i basic blocks, %s for code caching\n", rom_filename,
+        analysis->rom_end - PROGRAM_START_ADDR, analysis->block_count,
+        analysis->is_cache_safe ? "safe" : "NOT safe");
+
+    for (int i = 0; i < analysis->note_count; i++) {
+        const AnalysisNote *note = &analysis->notes[i];
+        format_instruction(opcode_at(ram, note->address), text, sizeof(text));
+        printf(";   %03X  %-24s %s", note->address, note_description(note->kind), text);
+        if (note->kind == NOTE_CODE_WRITE) {
+            printf("  (I = 0x%03X)", note->target);
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+    int address = 0;
+    while (address < TOTAL_RAM) {
+        const BasicBlock *block = find_block(analysis, address);
+
+        if (block != NULL) {
+            print_block(ram, block);
+            address = block->end;
+        }
+        else if (address >= PROGRAM_START_ADDR && address < analysis->rom_end &&
+                 (analysis->flags[address] & (ADDR_CODE | ADDR_OPERAND)) == 0) {
+            address = print_data(ram, analysis, address);
+        }
+        else {
+            address++;
+        }
+    }
+}
+
+
+static void print_dot(const uint8_t *ram, const RomAnalysis *analysis) {
+    char text[32];
+
+    printf("digraph rom {\n");
+    printf("    node [shape=box fontname=\"monospace\"];\n");
+
+    for (int i = 0; i < analysis->block_count; i++) {
+        const BasicBlock *block = &analysis->blocks[i];
+        int flagged = FALSE;
+
+        for (int n = 0; n < analysis->note_count; n++) {
+            if (analysis->notes[n].address >= block->start && analysis->notes[n].address < block->end) {
+                flagged = TRUE;
+            }
+        }
+
+        printf("    b%03X [label=\"", block->start);
+        for (uint16_t address = block->start; address < block->end; address += 2) {
+            format_instruction(opcode_at(ram, address), text, sizeof(text));
+            printf("%03X  %s\\l", address, text);
+        }
+        printf("\"%s];\n", flagged ? " color=red" : "");
+
+        for (int s = 0; s < block->successor_count; s++) {
+            // The return site of a call is reached through the stack, draw it dashed
+            int is_return_site = block->exit_flow == FLOW_CALL && s == 1;
+            printf("    b%03X -> b%03X%s;\n", block->start, block->successors[s],
+                is_return_site ? " [style=dashed]" : "");
+        }
+    }
+
+    printf("}\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    static uint8_t ram[TOTAL_RAM];
+    static RomAnalysis analysis;
+    uint8_t quirks = QUIRKS_LEGACY;
+    int dot = FALSE;
+
+    if (argc < 2) {
+        printf("Program Usage: ./chip8-dis path/to/rom [dot] [legacy|vip|schip|xochip]\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "dot") == 0) {dot = TRUE;}
+        else if (!parse_quirk_profile(argv[i], &quirks)) {
+            printf("ERROR: Unrecognized option or quirk profile %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(ram, FONTSET, FONTSET_SIZE);
+    uint16_t rom_end = read_rom(argv[1], ram);
+    analyze_rom(ram, rom_end, quirks, &analysis);
+
+    if (dot) {
+        print_dot(ram, &analysis);
+    }
+    else {
+        print_listing(ram, &analysis, argv[1]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+* Chip8 Fuzz Target
+*
+* Runs one input through the headless core in process and aborts when the
+* system ends up in a state it should never reach. Errors a rom can cause
+* (unrecognized opcodes, stack overflow and underflow) are reported through
+* chip8->error and are not crashes.
+*
+* Input layout:
+*     byte 0      quirk flags (QUIRK_*, masked to QUIRK_COMBINATIONS)
+*     bytes 1-2   key mask held for the whole run, bit i = key i
+*     the rest    the rom, loaded at 0x200
+*
+* Built with -DCHIP8_LIBFUZZER this is only LLVMFuzzerTestOneInput, for
+* clang -fsanitize=fuzzer (make fuzz). Otherwise it has its own driver:
+*
+* Example: <unix> ./chip8-fuzz                   100000 random inputs
+*          <unix> ./chip8-fuzz -runs=5000000     5000000 random inputs
+*          <unix> ./chip8-fuzz crash-1 crash-2   replay the given inputs
+*/
+
+#include <string.h>
+#include <time.h>
+#include "api.h"
+
+#define FUZZ_HEADER_SIZE 3
+#define FUZZ_FRAMES 64                   // 576 instructions, enough for most loops to come around
+#define FUZZ_DEFAULT_RUNS 100000
+#define FUZZ_MAX_INPUT (FUZZ_HEADER_SIZE + TOTAL_RAM - PC_START)
+#define FUZZ_SEED 0x8C8
+#define FUZZ_HASH_CHECK_INTERVAL 64      // recomputing the hashes costs more than a run
+
+// The system is reused between inputs, init_system puts it back in its startup state
+static Chip8 fuzz_chip8;
+
+
+// Stops the fuzzer with the broken invariant, abort() is what the sanitizers and libFuzzer catch
+static void check(int condition, const char *invariant) {
+    if (!condition) {
+        fprintf(stderr, "Invariant broken: %s\n", invariant);
+        abort();
+    }
+}
+
+
+static void check_invariants(const Chip8 *chip8) {
+    static unsigned checked;
+
+    check(chip8->sp_reg <= STACK_SIZE, "sp_reg <= STACK_SIZE");
+    check(chip8->error <= CHIP8_ERROR_STACK_UNDERFLOW, "error is a Chip8Error");
+    check(chip8->is_running_flag || chip8->error != CHIP8_OK, "the system only stops with an error");
+
+    if (checked++ % FUZZ_HASH_CHECK_INTERVAL == 0) {
+        check(chip8->ram_hash == compute_ram_hash(chip8), "ram_hash follows every ram write");
+        check(chip8->screen_hash == compute_screen_hash(chip8), "screen_hash follows every pixel flip");
+    }
+
+    const uint8_t *pixels = &chip8->screen[0][0];
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        check(pixels[i] <= 1, "pixels are 0 or 1");
+    }
+}
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < FUZZ_HEADER_SIZE || size > FUZZ_MAX_INPUT) {
+        return 0;
+    }
+
+    Chip8 *chip8 = &fuzz_chip8;
+    chip8_load(chip8, data + FUZZ_HEADER_SIZE, size - FUZZ_HEADER_SIZE);
+    chip8->quirks = data[0] & (QUIRK_COMBINATIONS - 1);
+    chip8_set_keys(chip8, (uint16_t)(data[1] | data[2] << 8));
+
+    chip8_step_frames(chip8, FUZZ_FRAMES, NULL, NULL);
+    check_invariants(chip8);
+    return 0;
+}
+
+
+#ifndef CHIP8_LIBFUZZER
+
+static void replay_file(const char *path) {
+    static uint8_t data[FUZZ_MAX_INPUT + 1];
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("ERROR: Could not open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    LLVMFuzzerTestOneInput(data, size);
+    printf("%s: %s (pc 0x%X, opcode 0x%X)\n", path, chip8_error_string(fuzz_chip8.error),
+           fuzz_chip8.pc_reg, fuzz_chip8.current_op);
+}
+
+
+// xorshift64, rand() one byte at a time costs more than running the input
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+/*
+* Random inputs from a fixed seed, so a run can be repeated. Most random
+* roms stop on an unrecognized opcode within a few instructions, which is
+* what makes the reset cost matter.
+*/
+static void random_runs(long runs) {
+    static uint8_t data[FUZZ_MAX_INPUT + sizeof(uint64_t)];
+    long errors[CHIP8_ERROR_STACK_UNDERFLOW + 1] = {0};
+    uint64_t state = FUZZ_SEED;
+
+    clock_t start = clock();
+
+    for (long run = 0; run < runs; run++) {
+        size_t size = FUZZ_HEADER_SIZE + next_random(&state) % (FUZZ_MAX_INPUT - FUZZ_HEADER_SIZE + 1);
+        for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+            uint64_t bytes = next_random(&state);
+            memcpy(&data[i], &bytes, sizeof(bytes));
+        }
+
+        LLVMFuzzerTestOneInput(data, size);
+        errors[fuzz_chip8.error]++;
+    }
+
+    double elapsed_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Runs: %ld in %.2f s (%.0f execs/s)\n", runs, elapsed_time, runs / elapsed_time);
+    for (int error = CHIP8_OK; error <= CHIP8_ERROR_STACK_UNDERFLOW; error++) {
+        printf("  %-20s %ld\n", chip8_error_string(error), errors[error]);
+    }
+}
+
+
+int main(int argc, char **argv) {
+    long runs = FUZZ_DEFAULT_RUNS;
+    int replayed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = atol(argv[i] + 6);
+        }
+        else {
+            replay_file(argv[i]);
+            replayed++;
+        }
+    }
+
+    if (replayed == 0) {
+        random_runs(runs);
+    }
+    return 0;
+}
+
+#endif // CHIP8_LIBFUZZER
@@ -0,0 +1,686 @@
+/*
+* Chip8 Lockstep Runner
+*
+* Runs a rom on the reference core and on a candidate core side by side
+* with the same inputs and compares the machine state after every
+* instruction (or every N instructions with every=N). On the first
+* difference it prints the fields that differ and the instructions that
+* led up to it, and exits with status 1.
+*
+* The reference core is written out in this file on its own machine state,
+* one switch over the opcode nibbles that reads the quirks at run time. It
+* shares no code with the core in src/ (no decode table, no handlers, no
+* quirks.h), so a mistake there shows up as a difference instead of on both
+* sides. The candidates are:
+*   interp  execute_instruction, the interpreter specialised per quirk combination (default)
+*   run     run_instructions, its dispatch loop, a whole window at a time
+*   aot     execute_translated, the blocks of a rom translated by chip8-recomp,
+*           only in the build of make lockstep-aot
+*
+* Besides the machine state, the candidate's ram_hash and screen_hash are
+* checked against hashes worked out from scratch.
+*
+* Example: <unix> ./chip8-lockstep rom_dir/rom_name [engine=NAME] [quirks=NAME] [frames=N]
+*                 [cycles=N] [every=N] [movie=FILE] [seed=N] [trace=N]
+*
+* A frame is cycles=N instructions (CYCLES_PER_FRAME by default) and a
+* timer update, movies are "frame keys" lines like the ones of
+* chip8-regress. With every=N a difference is found N instructions late,
+* both cores are then taken back to the last state they agreed on and run
+* again one instruction at a time to find the instruction that caused it.
+*
+* A translated block runs whole, so engine=aot only runs the blocks that
+* fit in what is left of the window and interprets the rest. Windows are
+* every=N instructions and end at a frame, so it takes every=N and
+* cycles=N as long as the blocks to cover all of them, make aot-check
+* runs the test roms with 64 of each. The number of instructions that
+* ran translated is printed at the end, and a difference is narrowed
+* down to the block it came from.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <string.h>
+#include <time.h>
+#include "api.h"
+#include "quirks.h"
+#ifdef CHIP8_AOT
+#include "aot.h"
+#endif
+
+#define DEFAULT_FRAMES 3600
+#define DEFAULT_TRACE 16
+#define MAX_TRACE 1024
+#define MAX_MOVIE_EVENTS 4096
+#define RNG_SEED 0x8C8
+
+typedef enum {
+    ENGINE_INTERP,
+    ENGINE_RUN,
+#ifdef CHIP8_AOT
+    ENGINE_AOT,
+#endif
+    ENGINE_COUNT
+} Engine;
+
+typedef struct {
+    int frame;
+    uint16_t keys;
+} MovieEvent;
+
+typedef struct {
+    uint64_t instruction;
+    uint16_t pc;
+    uint16_t opcode;
+} TraceEntry;
+
+// State of the reference core, what the fields of Chip8 with the same meaning are compared to
+typedef struct {
+    uint8_t V[NUM_V_REGISTERS];
+    uint16_t I;
+    uint16_t pc;
+    uint8_t sp;
+    uint16_t stack[STACK_SIZE];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint16_t keys;
+    uint32_t rng_state;
+    uint8_t quirks;
+    uint8_t running;
+    uint8_t error;
+    uint16_t opcode;                // last one run
+    uint8_t ram[TOTAL_RAM];
+    uint8_t screen[SCREEN_HEIGHT][SCREEN_WIDTH];
+} Reference;
+
+typedef struct {
+    Engine engine;
+    Reference reference;
+    Chip8 candidate;
+    int cycles;                     // instructions per frame
+    uint64_t instructions;          // run on each core so far
+    uint64_t translated;            // of those, run by the candidate in translated blocks
+    int compare_blocks;             // engine=aot compares after every block and stops at a difference
+    int block_differs;
+    int last_block;                 // instructions run by the last block, 1 if it was interpreted
+
+    const MovieEvent *events;
+    int event_count;
+
+    TraceEntry trace[MAX_TRACE];    // reference instructions, a ring
+    int trace_length;
+    uint64_t traced;
+} Lockstep;
+
+
+static const char *ENGINE_NAMES[] = {
+    "interp", "run",
+#ifdef CHIP8_AOT
+    "aot",
+#endif
+};
+
+
+// Fresh reference with the font at 0 and the rom at PROGRAM_START_ADDR, the rom has been checked to fit
+static void reference_load(Reference *reference, const uint8_t *rom, size_t rom_length, uint8_t quirks, uint32_t seed) {
+    memset(reference, 0, sizeof(Reference));
+    memcpy(reference->ram, FONTSET, FONTSET_SIZE);
+    memcpy(&reference->ram[PROGRAM_START_ADDR], rom, rom_length);
+    reference->pc = PC_START;
+    reference->quirks = quirks;
+    reference->rng_state = seed != 0 ? seed : DEFAULT_RNG_SEED;
+    reference->running = TRUE;
+    reference->error = CHIP8_OK;
+}
+
+
+static void reference_stop(Reference *reference, uint8_t error) {
+    reference->error = error;
+    reference->running = FALSE;
+}
+
+
+// Draws a sprite pixel by pixel, clipped or wrapped at the screen edge
+static void reference_draw(Reference *reference, uint8_t x, uint8_t y, uint8_t height) {
+    int clip = reference->quirks & QUIRK_CLIP;
+    unsigned left = reference->V[x] % SCREEN_WIDTH;
+    unsigned top = reference->V[y] % SCREEN_HEIGHT;
+
+    reference->V[0xF] = 0;
+    for (unsigned row = 0; row < height; row++) {
+        if (clip && top + row >= SCREEN_HEIGHT) {break;}
+        uint8_t sprite = reference->ram[(reference->I + row) % TOTAL_RAM];
+
+        for (unsigned column = 0; column < 8; column++) {
+            if (clip && left + column >= SCREEN_WIDTH) {break;}
+            uint8_t *pixel = &reference->screen[(top + row) % SCREEN_HEIGHT][(left + column) % SCREEN_WIDTH];
+
+            if (sprite & (0x80 >> column)) {
+                if (*pixel) {reference->V[0xF] = 1;}
+                *pixel ^= 1;
+            }
+        }
+    }
+}
+
+
+/*
+* One instruction of the reference core. Addresses wrap at TOTAL_RAM, an
+* opcode that encodes no instruction and a stack that over or underflows
+* stop the core with the Chip8Error of the same name, the pc left on the
+* instruction
+*/
+static void reference_step(Lockstep *lockstep) {
+    Reference *reference = &lockstep->reference;
+    uint16_t opcode = reference->ram[reference->pc % TOTAL_RAM] << 8 | reference->ram[(reference->pc + 1) % TOTAL_RAM];
+    uint8_t x = (opcode >> 8) & 0xF;
+    uint8_t y = (opcode >> 4) & 0xF;
+    uint8_t kk = opcode & 0xFF;
+    uint16_t nnn = opcode & 0xFFF;
+    uint8_t *V = reference->V;
+    uint16_t next = reference->pc + 2;
+    int invalid = FALSE;
+
+    TraceEntry *entry = &lockstep->trace[lockstep->traced++ % lockstep->trace_length];
+    entry->instruction = lockstep->instructions;
+    entry->pc = reference->pc;
+    entry->opcode = opcode;
+    reference->opcode = opcode;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) {memset(reference->screen, 0, sizeof(reference->screen));}
+            else if (opcode == 0x00EE) {
+                if (reference->sp == 0) {
+                    reference_stop(reference, CHIP8_ERROR_STACK_UNDERFLOW);
+                    return;
+                }
+                next = reference->stack[--reference->sp] + 2;
+            }
+            else {invalid = TRUE;}
+            break;
+        case 0x1: next = nnn; break;
+        case 0x2:
+            if (reference->sp == STACK_SIZE) {
+                reference_stop(reference, CHIP8_ERROR_STACK_OVERFLOW);
+                return;
+            }
+            reference->stack[reference->sp++] = reference->pc;
+            next = nnn;
+            break;
+        case 0x3: next += V[x] == kk ? 2 : 0; break;
+        case 0x4: next += V[x] != kk ? 2 : 0; break;
+        case 0x5: next += V[x] == V[y] ? 2 : 0; break;
+        case 0x6: V[x] = kk; break;
+        case 0x7: V[x] += kk; break;
+        case 0x8: {
+            // Where V[F] is written decides the result when x or y is F, it goes in the order the core uses
+            uint8_t shifted = V[(reference->quirks & QUIRK_SHIFT_VY) ? y : x];
+            uint16_t sum = V[x] + V[y];
+            int vf_reset = reference->quirks & QUIRK_VF_RESET;
+            switch (opcode & 0xF) {
+                case 0x0: V[x] = V[y]; break;
+                case 0x1: V[x] |= V[y]; if (vf_reset) {V[0xF] = 0;} break;
+                case 0x2: V[x] &= V[y]; if (vf_reset) {V[0xF] = 0;} break;
+                case 0x3: V[x] ^= V[y]; if (vf_reset) {V[0xF] = 0;} break;
+                case 0x4: V[0xF] = sum > 0xFF; V[x] = sum; break;
+                case 0x5: V[0xF] = V[x] > V[y]; V[x] -= V[y]; break;
+                case 0x6: V[0xF] = shifted & 1; V[x] = shifted >> 1; break;
+                case 0x7: V[0xF] = V[y] > V[x]; V[x] = V[y] - V[x]; break;
+                case 0xE: V[0xF] = shifted >> 7; V[x] = shifted << 1; break;
+                default: invalid = TRUE; break;
+            }
+            break;
+        }
+        case 0x9: next += V[x] != V[y] ? 2 : 0; break;
+        case 0xA: reference->I = nnn; break;
+        case 0xB: next = nnn + V[(reference->quirks & QUIRK_JUMP_VX) ? x : 0]; break;
+        case 0xC:
+            reference->rng_state ^= reference->rng_state << 13;
+            reference->rng_state ^= reference->rng_state >> 17;
+            reference->rng_state ^= reference->rng_state << 5;
+            V[x] = (reference->rng_state >> 24) & kk;
+            break;
+        case 0xD: reference_draw(reference, x, y, opcode & 0xF); break;
+        case 0xE:
+            if (kk == 0x9E) {next += (reference->keys >> (V[x] & 0xF)) & 1 ? 2 : 0;}
+            else if (kk == 0xA1) {next += (reference->keys >> (V[x] & 0xF)) & 1 ? 0 : 2;}
+            else {invalid = TRUE;}
+            break;
+        case 0xF:
+            switch (kk) {
+                case 0x07: V[x] = reference->delay_timer; break;
+                case 0x0A:
+                    // Waits on the instruction until a key is held, the highest one held is taken
+                    if (reference->keys == 0) {
+                        next = reference->pc;
+                        break;
+                    }
+                    for (int key = NUM_KEYS - 1; key >= 0; key--) {
+                        if (reference->keys & (1 << key)) {
+                            V[x] = key;
+                            break;
+                        }
+                    }
+                    break;
+                case 0x15: reference->delay_timer = V[x]; break;
+                case 0x18: reference->sound_timer = V[x]; break;
+                case 0x1E: reference->I += V[x]; break;
+                case 0x29: reference->I = V[x] * 5; break;
+                case 0x33:
+                    reference->ram[reference->I % TOTAL_RAM] = V[x] / 100;
+                    reference->ram[(reference->I + 1) % TOTAL_RAM] = V[x] / 10 % 10;
+                    reference->ram[(reference->I + 2) % TOTAL_RAM] = V[x] % 10;
+                    break;
+                case 0x55:
+                case 0x65:
+                    for (int i = 0; i <= x; i++) {
+                        uint8_t *byte = &reference->ram[(reference->I + i) % TOTAL_RAM];
+                        if (kk == 0x55) {*byte = V[i];}
+                        else {V[i] = *byte;}
+                    }
+                    if (reference->quirks & QUIRK_INCREMENT_I) {reference->I += x + 1;}
+                    break;
+                default: invalid = TRUE; break;
+            }
+            break;
+    }
+
+    if (invalid) {
+        reference_stop(reference, CHIP8_ERROR_INVALID_OPCODE);
+        return;
+    }
+    reference->pc = next;
+}
+
+
+static void reference_timers(Reference *reference) {
+    if (reference->delay_timer > 0) {reference->delay_timer--;}
+    if (reference->sound_timer > 0) {reference->sound_timer--;}
+}
+
+
+// One instruction of the reference core, counted
+static int reference_follow(Lockstep *lockstep) {
+    if (!lockstep->reference.running) {return FALSE;}
+    reference_step(lockstep);
+    lockstep->instructions++;
+    return TRUE;
+}
+
+
+#ifdef CHIP8_AOT
+static int print_differences(const Reference *reference, const Chip8 *candidate, int quiet);
+
+
+/*
+* The candidate runs first and the reference follows it by the number of
+* instructions it ran. A block longer than what is left of the window is
+* interpreted one instruction at a time instead
+*/
+static int step_translated(Lockstep *lockstep, int count) {
+    Chip8 *candidate = &lockstep->candidate;
+    int executed = 0;
+
+    while (executed < count && lockstep->reference.running) {
+        int step = 1;
+        if (candidate->is_running_flag && translated_length(candidate) <= count - executed) {
+            const uint8_t *ops;
+            step = execute_translated(candidate, FALSE, &ops);
+            if (ops != &candidate->current_op_id) {lockstep->translated += step;}
+        }
+        else if (candidate->is_running_flag) {
+            execute_instruction(candidate, FALSE);
+        }
+        lockstep->last_block = step;
+
+        for (int i = 0; i < step && reference_follow(lockstep); i++) {
+            executed++;
+        }
+        if (lockstep->compare_blocks && print_differences(&lockstep->reference, candidate, TRUE)) {
+            lockstep->block_differs = TRUE;
+            break;
+        }
+    }
+    return executed;
+}
+#endif
+
+
+// Runs count instructions on both cores, fewer if the reference stops
+static int step_both(Lockstep *lockstep, int count) {
+    int executed = 0;
+
+#ifdef CHIP8_AOT
+    if (lockstep->engine == ENGINE_AOT) {
+        return step_translated(lockstep, count);
+    }
+#endif
+
+    while (executed < count && reference_follow(lockstep)) {
+        executed++;
+    }
+
+    if (lockstep->engine == ENGINE_RUN) {
+        run_instructions(&lockstep->candidate, executed);
+    }
+    else {
+        for (int i = 0; i < executed && lockstep->candidate.is_running_flag; i++) {
+            execute_instruction(&lockstep->candidate, FALSE);
+        }
+    }
+    return executed;
+}
+
+
+// Keys of the movie held in a frame
+static uint16_t movie_keys(const Lockstep *lockstep, uint64_t frame) {
+    uint16_t keys = 0;
+
+    for (int i = 0; i < lockstep->event_count && (uint64_t)lockstep->events[i].frame <= frame; i++) {
+        keys = lockstep->events[i].keys;
+    }
+    return keys;
+}
+
+
+/*
+* Runs count instructions on both cores in frames: the movie keys are set
+* at the start of a frame and the timers updated after its last
+* instruction. Everything follows from the instruction count, so running
+* again from a saved state repeats the same frames
+*/
+static void advance(Lockstep *lockstep, uint64_t count) {
+    int cycles = lockstep->cycles;
+
+    while (count > 0 && lockstep->reference.running && !lockstep->block_differs) {
+        int position = lockstep->instructions % cycles;
+        if (position == 0) {
+            uint16_t keys = movie_keys(lockstep, lockstep->instructions / cycles);
+            lockstep->reference.keys = keys;
+            chip8_set_keys(&lockstep->candidate, keys);
+        }
+
+        int window = (uint64_t)(cycles - position) < count ? cycles - position : (int)count;
+        int executed = step_both(lockstep, window);
+        count -= executed;
+
+        if (executed == window && lockstep->instructions % cycles == 0) {
+            reference_timers(&lockstep->reference);
+            update_timers(&lockstep->candidate);
+        }
+    }
+}
+
+
+// Prints the differences between the cores, returns TRUE if there are any
+static int print_differences(const Reference *reference, const Chip8 *candidate, int quiet) {
+    int differences = 0;
+
+#define COMPARE(label, expected, actual) \
+    if ((expected) != (actual)) { \
+        if (!quiet) {printf("  %-14s reference 0x%llX  candidate 0x%llX\n", label, \
+                            (unsigned long long)(expected), (unsigned long long)(actual));} \
+        differences++; \
+    }
+
+    char name[16];
+    for (int i = 0; i < NUM_V_REGISTERS; i++) {
+        snprintf(name, sizeof(name), "V%X", i);
+        COMPARE(name, reference->V[i], candidate->V[i]);
+    }
+    COMPARE("I", reference->I, candidate->I_reg);
+    COMPARE("PC", reference->pc, candidate->pc_reg);
+    COMPARE("SP", reference->sp, candidate->sp_reg);
+    COMPARE("delay timer", reference->delay_timer, candidate->delay_timer);
+    COMPARE("sound timer", reference->sound_timer, candidate->sound_timer);
+    COMPARE("running", reference->running, candidate->is_running_flag);
+    COMPARE("error", reference->error, candidate->error);
+    COMPARE("random state", reference->rng_state, candidate->rng_state);
+    for (int i = 0; i < STACK_SIZE && i < reference->sp; i++) {
+        snprintf(name, sizeof(name), "stack[%i]", i);
+        COMPARE(name, reference->stack[i], candidate->stack[i]);
+    }
+
+    // The candidate keeps its hashes incrementally, they have to equal the ones from scratch
+    COMPARE("ram hash", compute_ram_hash(candidate), candidate->ram_hash);
+    COMPARE("screen hash", compute_screen_hash(candidate), candidate->screen_hash);
+#undef COMPARE
+
+    int pixels = 0;
+    for (int i = 0; i < SCREEN_HEIGHT * SCREEN_WIDTH; i++) {
+        pixels += (&reference->screen[0][0])[i] != (&candidate->screen[0][0])[i];
+    }
+    if (pixels > 0) {
+        if (!quiet) {printf("  %-14s %i pixels differ\n", "screen", pixels);}
+        differences++;
+    }
+
+    for (int i = 0; i < TOTAL_RAM; i++) {
+        if (reference->ram[i] != read_ram(candidate, i)) {
+            if (!quiet) {printf("  %-14s first difference at 0x%03X: reference 0x%02X  candidate 0x%02X\n", "ram", i,
+                                reference->ram[i], read_ram(candidate, i));}
+            differences++;
+            break;
+        }
+    }
+    return differences > 0;
+}
+
+
+static void print_trace(const Lockstep *lockstep) {
+    char text[64];
+    uint64_t count = lockstep->traced < (uint64_t)lockstep->trace_length ? lockstep->traced : (uint64_t)lockstep->trace_length;
+
+    printf("Last %llu instructions (reference):\n", (unsigned long long)count);
+    for (uint64_t i = lockstep->traced - count; i < lockstep->traced; i++) {
+        const TraceEntry *entry = &lockstep->trace[i % lockstep->trace_length];
+        format_instruction(entry->opcode, text, sizeof(text));
+        printf("  %10llu  0x%03X  %04X  %s\n", (unsigned long long)entry->instruction, entry->pc, entry->opcode, text);
+    }
+}
+
+
+static int read_movie(const char *movie_filename, MovieEvent *events) {
+    FILE *movie = fopen(movie_filename, "r");
+    if (movie == NULL) {
+        printf("ERROR: Movie file does not exist\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char text[128];
+    int count = 0;
+    while (fgets(text, sizeof(text), movie) != NULL && count < MAX_MOVIE_EVENTS) {
+        unsigned keys;
+        if (text[0] != '#' && sscanf(text, "%i %x", &events[count].frame, &keys) == 2) {
+            events[count++].keys = keys;
+        }
+    }
+
+    fclose(movie);
+    return count;
+}
+
+
+static uint8_t *read_rom(const char *rom_filename, size_t *rom_length) {
+    static uint8_t rom[TOTAL_RAM];
+
+    FILE *file = fopen(rom_filename, "rb");
+    if (file == NULL) {
+        printf("ERROR: ROM file does not exist\n");
+        exit(EXIT_FAILURE);
+    }
+    *rom_length = fread(rom, 1, sizeof(rom), file);
+    fclose(file);
+    return rom;
+}
+
+
+int main(int argc, char *argv[]) {
+    static Lockstep lockstep;
+    static Reference saved_reference;
+    static Chip8 saved_candidate;
+    static TraceEntry saved_trace[MAX_TRACE];
+    static MovieEvent events[MAX_MOVIE_EVENTS];
+    uint8_t quirks = QUIRKS_LEGACY;
+    long frames = DEFAULT_FRAMES;
+    long every = 1;
+    uint32_t seed = RNG_SEED;
+
+    if (argc < 2) {
+        printf("Program Usage: ./chip8-lockstep path/to/rom [engine=interp|run|aot] [quirks=NAME] [frames=N] [cycles=N] [every=N] [movie=FILE] [seed=N] [trace=N]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    lockstep.engine = ENGINE_INTERP;
+    lockstep.cycles = CYCLES_PER_FRAME;
+    lockstep.events = events;
+    lockstep.trace_length = DEFAULT_TRACE;
+    for (int i = 2; i < argc; i++) {
+        int valid = TRUE;
+
+        if (strncmp(argv[i], "engine=", 7) == 0) {
+            valid = FALSE;
+            for (int engine = ENGINE_INTERP; engine < ENGINE_COUNT; engine++) {
+                if (strcmp(argv[i] + 7, ENGINE_NAMES[engine]) == 0) {
+                    lockstep.engine = engine;
+                    valid = TRUE;
+                }
+            }
+        }
+        else if (strncmp(argv[i], "quirks=", 7) == 0) {valid = parse_quirk_profile(argv[i] + 7, &quirks);}
+        else if (strncmp(argv[i], "frames=", 7) == 0) {
+            frames = atol(argv[i] + 7);
+            valid = frames > 0;
+        }
+        else if (strncmp(argv[i], "cycles=", 7) == 0) {
+            lockstep.cycles = atoi(argv[i] + 7);
+            valid = lockstep.cycles > 0;
+        }
+        else if (strncmp(argv[i], "every=", 6) == 0) {
+            every = atol(argv[i] + 6);
+            valid = every > 0;
+        }
+        else if (strncmp(argv[i], "movie=", 6) == 0) {lockstep.event_count = read_movie(argv[i] + 6, events);}
+        else if (strncmp(argv[i], "seed=", 5) == 0) {seed = strtoul(argv[i] + 5, NULL, 0);}
+        else if (strncmp(argv[i], "trace=", 6) == 0) {
+            lockstep.trace_length = atoi(argv[i] + 6);
+            valid = lockstep.trace_length > 0 && lockstep.trace_length <= MAX_TRACE;
+        }
+        else {valid = FALSE;}
+
+        if (!valid) {
+            printf("ERROR: Unrecognized option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t rom_length;
+    const uint8_t *rom = read_rom(argv[1], &rom_length);
+    if (!chip8_load(&lockstep.candidate, rom, rom_length)) {
+        printf("ERROR: ROM file too large\n");
+        exit(EXIT_FAILURE);
+    }
+    lockstep.candidate.quirks = quirks;
+    seed_random(&lockstep.candidate, seed);
+    reference_load(&lockstep.reference, rom, rom_length, quirks, seed);
+
+#ifdef CHIP8_AOT
+    if (lockstep.engine == ENGINE_AOT) {
+        if (quirks != AOT_QUIRKS) {
+            printf("WARNING: The rom was translated for quirks %s, every instruction is interpreted\n",
+                   quirk_profile_name(AOT_QUIRKS));
+        }
+        init_aot();
+    }
+#endif
+    saved_reference = lockstep.reference;
+    saved_candidate = lockstep.candidate;
+    uint64_t saved_traced = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Compare every N instructions. A difference found late is looked for again from the
+    // last state both cores agreed on, one instruction at a time
+    uint64_t total = (uint64_t)frames * lockstep.cycles;
+    uint64_t saved_instructions = 0;
+    int diverged = FALSE;
+    while (lockstep.instructions < total && lockstep.reference.running) {
+        uint64_t window = total - lockstep.instructions < (uint64_t)every ? total - lockstep.instructions : (uint64_t)every;
+        advance(&lockstep, window);
+
+        if (!print_differences(&lockstep.reference, &lockstep.candidate, TRUE)) {
+            if (every > 1) {
+                saved_reference = lockstep.reference;
+                saved_candidate = lockstep.candidate;
+                saved_instructions = lockstep.instructions;
+                memcpy(saved_trace, lockstep.trace, lockstep.trace_length * sizeof(TraceEntry));
+                saved_traced = lockstep.traced;
+            }
+            continue;
+        }
+
+        if (every > 1) {
+            uint64_t replay = lockstep.instructions - saved_instructions;
+            lockstep.reference = saved_reference;
+            lockstep.candidate = saved_candidate;
+            lockstep.instructions = saved_instructions;
+            // The trace too, or the window would be listed twice
+            memcpy(lockstep.trace, saved_trace, lockstep.trace_length * sizeof(TraceEntry));
+            lockstep.traced = saved_traced;
+            uint64_t single_steps = replay;
+            int found = FALSE;
+#ifdef CHIP8_AOT
+            // One instruction at a time no block would run, the window is run again comparing after every block
+            if (lockstep.engine == ENGINE_AOT) {
+                lockstep.compare_blocks = TRUE;
+                advance(&lockstep, replay);
+                found = lockstep.block_differs;
+                single_steps = 0;
+            }
+#endif
+            for (uint64_t i = 0; i < single_steps && !found; i++) {
+                advance(&lockstep, 1);
+                found = print_differences(&lockstep.reference, &lockstep.candidate, TRUE);
+            }
+            // The cores are not deterministic, report the window instead
+            if (!found) {
+                printf("WARNING: The difference did not come back on replay, it is somewhere in "
+                       "instructions %llu to %llu\n", (unsigned long long)saved_instructions,
+                       (unsigned long long)(saved_instructions + replay - 1));
+            }
+        }
+        diverged = TRUE;
+        break;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (diverged) {
+        printf("DIVERGED at instruction %llu (frame %llu), engine %s:\n", (unsigned long long)lockstep.instructions - 1,
+               (unsigned long long)(lockstep.instructions - 1) / lockstep.cycles, ENGINE_NAMES[lockstep.engine]);
+        print_differences(&lockstep.reference, &lockstep.candidate, FALSE);
+        if (lockstep.block_differs && lockstep.last_block > 1) {
+            printf("The last %i instructions ran as one translated block\n", lockstep.last_block);
+        }
+        print_trace(&lockstep);
+        return EXIT_FAILURE;
+    }
+
+    printf("%llu instructions over %llu frames agree, engine %s (%.1f M instructions/s)\n",
+           (unsigned long long)lockstep.instructions,
+           (unsigned long long)(lockstep.instructions + lockstep.cycles - 1) / lockstep.cycles, ENGINE_NAMES[lockstep.engine],
+           lockstep.instructions / seconds / 1e6);
+#ifdef CHIP8_AOT
+    if (lockstep.engine == ENGINE_AOT) {
+        printf("%llu of them ran translated\n", (unsigned long long)lockstep.translated);
+    }
+#endif
+    if (lockstep.reference.error != CHIP8_OK) {
+        printf("Both stopped: %s (opcode 0x%X at 0x%X)\n", chip8_error_string(lockstep.reference.error),
+               lockstep.reference.opcode, lockstep.reference.pc);
+    }
+    return 0;
+}
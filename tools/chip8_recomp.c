@@ -0,0 +1,331 @@
+/*
+* Chip8 Static Recompiler
+*
+* Translates a rom ahead of time into a C source file with one function per
+* basic block found by the rom analysis. The V registers a block uses are
+* kept in locals, simple instructions are translated inline and everything
+* else calls the interpreter's instruction handlers.
+*
+* The generated file is compiled and linked with the emulator, see the aot
+* target in the Makefile. Any pc without a translated block, or whose code
+* changed in ram, is run by the interpreter. A block is translated as
+* several functions when it writes ram (FX55, FX33): each write ends one,
+* so the code after it is checked against ram again before it runs. A
+* DXYN ends one too, so the frontend can stop the frame right after it.
+*
+* Instructions that depend on the quirk profile are translated for the
+* profile given (legacy by default). The translated blocks are only used
+* when the emulator runs with the same quirks.
+*
+* Example: <unix> ./chip8-recomp rom_dir/rom_name aot_rom.c [vip]
+*/
+
+#include <string.h>
+#include "analyze.h"
+#include "quirks.h"
+
+
+// C names of the instruction handlers, for instructions that are not translated inline
+static const char *HANDLER_NAMES[OPCODE_COUNT] = {
+    [OP_CLS] = "cls", [OP_RET] = "return_from_subroutine", [OP_JP] = "jump",
+    [OP_CALL] = "call_subroutine", [OP_SE_VX_KK] = "se_Vx_kk", [OP_SNE_VX_KK] = "sne_Vx_kk",
+    [OP_SE_VX_VY] = "se_Vx_Vy", [OP_LD_VX_KK] = "ld_Vx", [OP_ADD_VX_KK] = "add_Vx_imm",
+    [OP_LD_VX_VY] = "move_Vx_Vy", [OP_OR_VX_VY] = "or_Vx_Vy", [OP_AND_VX_VY] = "and_Vx_Vy",
+    [OP_XOR_VX_VY] = "xor_Vx_Vy", [OP_ADD_VX_VY] = "add_Vx_Vy", [OP_SUB_VX_VY] = "sub_Vx_Vy",
+    [OP_SHR_VX] = "shr", [OP_SUBN_VX_VY] = "subn_Vx_Vy", [OP_SHL_VX] = "shl",
+    [OP_SNE_VX_VY] = "sne_Vx_Vy", [OP_LD_I] = "ldi", [OP_JP_V0] = "jump_V0", [OP_RND] = "rnd",
+    [OP_DRW] = "drw", [OP_SKP] = "skp", [OP_SKNP] = "sknp", [OP_LD_VX_DT] = "ld_Vx_dt",
+    [OP_LD_VX_K] = "ld_Vx_k", [OP_LD_DT_VX] = "ld_dt_Vx", [OP_LD_ST_VX] = "ld_st_Vx",
+    [OP_ADD_I_VX] = "add_i_Vx", [OP_LD_F_VX] = "ld_F_Vx", [OP_LD_B_VX] = "st_bcd_Vx",
+    [OP_ST_V_REGS] = "st_V_regs", [OP_LD_V_REGS] = "ld_V_regs", [OP_INVALID] = NULL,
+};
+
+
+static uint16_t read_rom(const char *rom_filename, uint8_t *ram) {
+    FILE *rom = fopen(rom_filename, "rb");
+    if (rom == NULL) {
+        printf("ERROR: ROM file does not exist\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t rom_length = fread(ram + PROGRAM_START_ADDR, 1, PROGRAM_END_ADDR - PROGRAM_START_ADDR, rom);
+    if (fgetc(rom) != EOF) {
+        printf("ERROR: ROM file too large\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(rom);
+    return PROGRAM_START_ADDR + rom_length;
+}
+
+
+static uint16_t opcode_at(const uint8_t *ram, uint16_t address) {
+    return ram[address] << 8 | ram[address + 1];
+}
+
+
+// TRUE if the instruction is translated inline instead of calling its handler
+static int is_inline(OpcodeId id) {
+    switch (id) {
+        case OP_JP: case OP_SE_VX_KK: case OP_SNE_VX_KK: case OP_SE_VX_VY: case OP_SNE_VX_VY:
+        case OP_LD_VX_KK: case OP_ADD_VX_KK: case OP_LD_VX_VY: case OP_OR_VX_VY: case OP_AND_VX_VY:
+        case OP_XOR_VX_VY: case OP_ADD_VX_VY: case OP_SUB_VX_VY: case OP_SUBN_VX_VY: case OP_LD_I:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+
+/*
+* TRUE if a translated block has to return after the instruction: a ram
+* write may have changed the code that follows, and a DXYN ends the frame
+* when the timing waits for the display
+*/
+static int ends_translation(OpcodeId id) {
+    return id == OP_ST_V_REGS || id == OP_LD_B_VX || id == OP_DRW;
+}
+
+
+// Bitmask of the V registers the inline instructions of a block touch
+static uint16_t block_registers(const uint8_t *ram, uint16_t start, uint16_t end) {
+    uint16_t used = 0;
+
+    for (uint16_t address = start; address < end; address += 2) {
+        uint16_t opcode = opcode_at(ram, address);
+        OpcodeId id = decode_opcode(opcode);
+
+        if (!is_inline(id) || id == OP_JP || id == OP_LD_I) {
+            continue;
+        }
+        used |= 1 << ((opcode & 0x0F00) >> 8);
+        if (INSTRUCTION_TABLE[id].operands == OPERANDS_X_Y) {
+            used |= 1 << ((opcode & 0x00F0) >> 4);
+        }
+        if (id == OP_ADD_VX_VY || id == OP_SUB_VX_VY || id == OP_SUBN_VX_VY ||
+            id == OP_OR_VX_VY || id == OP_AND_VX_VY || id == OP_XOR_VX_VY) {
+            used |= 1 << 0xF;
+        }
+    }
+    return used;
+}
+
+
+static void emit_registers(FILE *out, uint16_t used, int to_chip8) {
+    for (int r = 0; r < NUM_V_REGISTERS; r++) {
+        if (used & (1 << r)) {
+            if (to_chip8) {
+                fprintf(out, "    chip8->V[0x%X] = v%X;\n", r, r);
+            }
+            else {
+                fprintf(out, "    v%X = chip8->V[0x%X];\n", r, r);
+            }
+        }
+    }
+}
+
+
+// Translates one inline instruction, skips and jumps set the pc_reg
+static void emit_inline(FILE *out, uint16_t address, uint16_t opcode, OpcodeId id, uint8_t quirks) {
+    unsigned x = (opcode & 0x0F00) >> 8;
+    unsigned y = (opcode & 0x00F0) >> 4;
+    unsigned kk = opcode & 0x00FF;
+    unsigned nnn = opcode & 0x0FFF;
+
+    switch (id) {
+        case OP_JP:
+            fprintf(out, "    chip8->pc_reg = 0x%03X;\n", nnn);
+            break;
+        case OP_SE_VX_KK:
+            fprintf(out, "    chip8->pc_reg = (v%X == 0x%02X) ? 0x%03X : 0x%03X;\n", x, kk, address + 4, address + 2);
+            break;
+        case OP_SNE_VX_KK:
+            fprintf(out, "    chip8->pc_reg = (v%X != 0x%02X) ? 0x%03X : 0x%03X;\n", x, kk, address + 4, address + 2);
+            break;
+        case OP_SE_VX_VY:
+            fprintf(out, "    chip8->pc_reg = (v%X == v%X) ? 0x%03X : 0x%03X;\n", x, y, address + 4, address + 2);
+            break;
+        case OP_SNE_VX_VY:
+            fprintf(out, "    chip8->pc_reg = (v%X != v%X) ? 0x%03X : 0x%03X;\n", x, y, address + 4, address + 2);
+            break;
+        case OP_LD_VX_KK:
+            fprintf(out, "    v%X = 0x%02X;\n", x, kk);
+            break;
+        case OP_ADD_VX_KK:
+            fprintf(out, "    v%X += 0x%02X;\n", x, kk);
+            break;
+        case OP_LD_VX_VY:
+            fprintf(out, "    v%X = v%X;\n", x, y);
+            break;
+        case OP_OR_VX_VY:
+            fprintf(out, "    v%X = v%X | v%X;%s\n", x, x, y, (quirks & QUIRK_VF_RESET) ? " vF = 0;" : "");
+            break;
+        case OP_AND_VX_VY:
+            fprintf(out, "    v%X = v%X & v%X;%s\n", x, x, y, (quirks & QUIRK_VF_RESET) ? " vF = 0;" : "");
+            break;
+        case OP_XOR_VX_VY:
+            fprintf(out, "    v%X = v%X ^ v%X;%s\n", x, x, y, (quirks & QUIRK_VF_RESET) ? " vF = 0;" : "");
+            break;
+        // The flag is written before the result, exactly like the handlers do
+        case OP_ADD_VX_VY:
+            fprintf(out, "    { uint16_t sum = v%X + v%X; vF = sum > 255; v%X = sum & 0xFF; }\n", x, y, x);
+            break;
+        case OP_SUB_VX_VY:
+            fprintf(out, "    vF = v%X > v%X; v%X -= v%X;\n", x, y, x, y);
+            break;
+        case OP_SUBN_VX_VY:
+            fprintf(out, "    vF = v%X > v%X; v%X = v%X - v%X;\n", y, x, x, y, x);
+            break;
+        case OP_LD_I:
+            fprintf(out, "    chip8->I_reg = 0x%03X;\n", nnn);
+            break;
+        default:
+            break;
+    }
+}
+
+
+/*
+* Emits the function for the code from start up to the end of its basic
+* block, the first invalid opcode or the first instruction that ends a
+* translation, whichever comes first. Returns the address after the last
+* instruction emitted, start if the code starts with an invalid opcode,
+* those are left to the interpreter to report
+*/
+static uint16_t emit_block(FILE *out, const uint8_t *ram, uint16_t start, uint16_t block_end, uint8_t quirks) {
+    uint16_t end = block_end;
+    int count = 0;
+    char text[32];
+
+    for (uint16_t address = start; address < block_end; address += 2) {
+        OpcodeId id = decode_opcode(opcode_at(ram, address));
+
+        // Stop in front of an invalid opcode so the interpreter reports it
+        if (id == OP_INVALID) {
+            end = address;
+            break;
+        }
+        if (ends_translation(id)) {
+            end = address + 2;
+            break;
+        }
+    }
+    if (end == start) {
+        return start;
+    }
+
+    uint16_t used = block_registers(ram, start, end);
+
+    fprintf(out, "static int block_%03X(Chip8 *chip8) {\n", start);
+    for (int r = 0; r < NUM_V_REGISTERS; r++) {
+        if (used & (1 << r)) {
+            fprintf(out, "    uint8_t v%X = chip8->V[0x%X];\n", r, r);
+        }
+    }
+
+    int sets_pc = FALSE;
+    for (uint16_t address = start; address < end; address += 2) {
+        uint16_t opcode = opcode_at(ram, address);
+        OpcodeId id = decode_opcode(opcode);
+        int is_last = address + 2 >= end;
+
+        format_instruction(opcode, text, sizeof(text));
+        fprintf(out, "\n    // %03X  %s\n", address, text);
+        count++;
+
+        if (is_inline(id)) {
+            emit_inline(out, address, opcode, id, quirks);
+
+            // Skips and jumps end the block, the registers are written back once the pc_reg is set
+            if (INSTRUCTION_TABLE[id].flow != FLOW_NEXT) {
+                emit_registers(out, used, TRUE);
+                sets_pc = TRUE;
+            }
+        }
+        else {
+            emit_registers(out, used, TRUE);
+            fprintf(out, "    chip8->pc_reg = 0x%03X;\n", address);
+            fprintf(out, "    chip8->current_op = 0x%04X;\n", opcode);
+            fprintf(out, "    %s(chip8);\n", HANDLER_NAMES[id]);
+            if (is_last) {
+                sets_pc = TRUE;
+            }
+            else {
+                emit_registers(out, used, FALSE);
+            }
+        }
+    }
+
+    if (!sets_pc) {
+        emit_registers(out, used, TRUE);
+        fprintf(out, "    chip8->pc_reg = 0x%03X;\n", end);
+    }
+
+    fprintf(out, "    return %i;\n}\n\n", count);
+    fprintf(out, "static const uint8_t code_%03X[] = {", start);
+    for (uint16_t address = start; address < end; address++) {
+        fprintf(out, "%s0x%02X", address == start ? "" : ", ", ram[address]);
+    }
+    fprintf(out, "};\n\n\n");
+    return end;
+}
+
+
+int main(int argc, char *argv[]) {
+    static uint8_t ram[TOTAL_RAM];
+    static RomAnalysis analysis;
+    static uint16_t starts[TOTAL_RAM / 2];
+
+    uint8_t quirks = QUIRKS_LEGACY;
+
+    if (argc < 3) {
+        printf("Program Usage: ./chip8-recomp path/to/rom output.c [quirk profile]\n");
+        exit(EXIT_FAILURE);
+    }
+    if (argc > 3 && !parse_quirk_profile(argv[3], &quirks)) {
+        printf("ERROR: Unrecognized quirk profile %s\n", argv[3]);
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(ram, FONTSET, FONTSET_SIZE);
+    uint16_t rom_end = read_rom(argv[1], ram);
+    analyze_rom(ram, rom_end, quirks, &analysis);
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        printf("ERROR: Could not create %s\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(out, "/*\n* Generated by chip8-recomp from %s, do not edit.\n", argv[1]);
+    fprintf(out, "* %i basic blocks, %s for code caching, %s quirks\n*/\n\n", analysis.block_count,
+        analysis.is_cache_safe ? "safe" : "NOT safe", quirk_profile_name(quirks));
+    fprintf(out, "#include \"aot.h\"\n\n");
+    fprintf(out, "const uint8_t AOT_QUIRKS = 0x%02X;\n\n\n", quirks);
+
+    // The functions of a basic block, one after each instruction that ends a translation
+    int function_count = 0;
+    int translated_count = 0;
+    for (int i = 0; i < analysis.block_count; i++) {
+        const BasicBlock *block = &analysis.blocks[i];
+        uint16_t start = block->start;
+        uint16_t end;
+
+        while (start < block->end && (end = emit_block(out, ram, start, block->end, quirks)) != start) {
+            translated_count += start == block->start;
+            starts[function_count++] = start;
+            start = end;
+        }
+    }
+
+    fprintf(out, "const AotBlock AOT_BLOCKS[] = {\n");
+    for (int i = 0; i < function_count; i++) {
+        fprintf(out, "    {0x%03X, sizeof(code_%03X), code_%03X, block_%03X},\n", starts[i], starts[i], starts[i], starts[i]);
+    }
+    fprintf(out, "    {0, 0, NULL, NULL}\n};\n\nconst int AOT_BLOCK_COUNT = %i;\n", function_count);
+
+    fclose(out);
+    printf("Translated %i of %i blocks from %s into %s (%i functions)\n", translated_count, analysis.block_count,
+           argv[1], argv[2], function_count);
+    return 0;
+}
@@ -0,0 +1,520 @@
+/*
+* Chip8 Golden Frame Regression Runner
+*
+* Runs test roms headless, hashes the screen (and optionally ram) at the
+* frames listed in a manifest and compares them with the golden hashes.
+* Every rom runs in its own process, as many at once as there are cores,
+* with the random number generator seeded the same way every time.
+*
+* Example: <unix> ./chip8-regress tests/manifest.txt
+*
+* Manifest lines (paths are relative to the manifest, # starts a comment):
+*     rom_path  quirks  movie  frame  kind  hash
+*     pong.ch8  legacy  -      600    screen  9c3a3b0e5c1d27f1
+*
+*   quirks  quirk profile (legacy, vip, schip, xochip)
+*   movie   input movie or - for none. Each line of a movie is
+*           "frame keys", the keys (hex mask, bit i = key i) are held from
+*           that frame until the next line
+*   kind    screen, ram or all (screen and ram)
+*   hash    64 bit FNV-1a hash in hex, - for a new entry
+*
+* With "update" after the manifest, the hashes in the manifest are replaced
+* with the ones from this run and the screens are saved as golden PBM
+* images in golden/ next to the manifest. A mismatch writes a PBM with the
+* golden screen (if there is one), the actual screen and their difference
+* side by side into the current directory.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "api.h"
+#include "quirks.h"
+
+#define MAX_CHECKS 4096
+#define MAX_NAME 256                     // rom, movie and manifest directory as written in the manifest
+#define MAX_PATH (2 * MAX_NAME)
+#define MAX_OUTPUT_PATH (4 * MAX_PATH)
+#define MAX_MOVIE_EVENTS 4096
+#define RNG_SEED 0x8C8
+
+typedef enum {
+    HASH_SCREEN = 1,
+    HASH_RAM = 2,
+    HASH_ALL = HASH_SCREEN | HASH_RAM
+} HashKind;
+
+typedef enum {
+    CHECK_PENDING,
+    CHECK_PASSED,
+    CHECK_FAILED,
+    CHECK_ERROR                 // the rom or movie could not be loaded, or the rom stopped early
+} CheckStatus;
+
+typedef struct {
+    int line;                   // line in the manifest
+    char rom[MAX_PATH];
+    char movie[MAX_PATH];       // empty for no movie
+    uint8_t quirks;
+    const char *quirks_name;
+    int frame;
+    HashKind kind;
+    int has_expected;
+    uint64_t expected;
+} Check;
+
+// Written by the worker processes into memory shared with the parent
+typedef struct {
+    CheckStatus status;
+    uint64_t actual;
+} CheckResult;
+
+typedef struct {
+    int frame;
+    uint16_t keys;
+} MovieEvent;
+
+
+static Check checks[MAX_CHECKS];
+static int check_count;
+static char manifest_dir[MAX_NAME];
+
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t hash_state(const Chip8 *chip8, HashKind kind) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    if (kind & HASH_SCREEN) {hash = fnv1a(hash, &chip8->screen[0][0], sizeof(chip8->screen));}
+    if (kind & HASH_RAM) {
+        uint8_t ram[TOTAL_RAM];
+        for (int i = 0; i < TOTAL_RAM; i++) {ram[i] = chip8_read_ram(chip8, i);}
+        hash = fnv1a(hash, ram, sizeof(ram));
+    }
+    return hash;
+}
+
+
+static void resolve_path(const char *path, char *resolved) {
+    if (path[0] == '/') {
+        snprintf(resolved, MAX_PATH, "%s", path);
+    }
+    else {
+        snprintf(resolved, MAX_PATH, "%s%s", manifest_dir, path);
+    }
+}
+
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash != NULL ? slash + 1 : path;
+}
+
+
+// Golden image of a check: golden/<rom>[-<movie>]-<quirks>-<frame>.pbm next to the manifest
+static void golden_path(const Check *check, char *path) {
+    char movie_part[MAX_PATH + 1] = "";
+
+    if (check->movie[0] != '\0') {
+        snprintf(movie_part, sizeof(movie_part), "-%s", base_name(check->movie));
+    }
+    snprintf(path, MAX_OUTPUT_PATH, "%sgolden/%s%s-%s-%i.pbm", manifest_dir, base_name(check->rom),
+        movie_part, check->quirks_name, check->frame);
+}
+
+
+static void read_manifest(const char *manifest_filename) {
+    FILE *manifest = fopen(manifest_filename, "r");
+    if (manifest == NULL) {
+        printf("ERROR: Manifest %s does not exist\n", manifest_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *slash = strrchr(manifest_filename, '/');
+    int dir_length = slash != NULL ? (int)(slash - manifest_filename) + 1 : 0;
+    snprintf(manifest_dir, sizeof(manifest_dir), "%.*s", dir_length, manifest_filename);
+
+    char text[1024];
+    int line = 0;
+    while (fgets(text, sizeof(text), manifest) != NULL) {
+        char rom[MAX_NAME], quirks[32], movie[MAX_NAME], kind[16], hash[32];
+        int frame;
+        line++;
+
+        char *comment = strchr(text, '#');
+        if (comment != NULL) {*comment = '\0';}
+
+        int fields = sscanf(text, "%255s %31s %255s %i %15s %31s", rom, quirks, movie, &frame, kind, hash);
+        if (fields <= 0) {
+            continue;
+        }
+        if (fields != 6 || frame < 0) {
+            printf("ERROR: %s:%i: expected rom, quirks, movie, frame, kind and hash\n", manifest_filename, line);
+            exit(EXIT_FAILURE);
+        }
+        if (check_count == MAX_CHECKS) {
+            printf("ERROR: More than %i checks in the manifest\n", MAX_CHECKS);
+            exit(EXIT_FAILURE);
+        }
+
+        Check *check = &checks[check_count++];
+        check->line = line;
+        check->frame = frame;
+        resolve_path(rom, check->rom);
+        if (strcmp(movie, "-") == 0) {
+            check->movie[0] = '\0';
+        }
+        else {
+            resolve_path(movie, check->movie);
+        }
+
+        if (!parse_quirk_profile(quirks, &check->quirks)) {
+            printf("ERROR: %s:%i: unrecognized quirk profile %s\n", manifest_filename, line, quirks);
+            exit(EXIT_FAILURE);
+        }
+        check->quirks_name = quirk_profile_name(check->quirks);
+
+        if (strcmp(kind, "screen") == 0) {check->kind = HASH_SCREEN;}
+        else if (strcmp(kind, "ram") == 0) {check->kind = HASH_RAM;}
+        else if (strcmp(kind, "all") == 0) {check->kind = HASH_ALL;}
+        else {
+            printf("ERROR: %s:%i: unrecognized kind %s\n", manifest_filename, line, kind);
+            exit(EXIT_FAILURE);
+        }
+
+        check->has_expected = strcmp(hash, "-") != 0;
+        check->expected = strtoull(hash, NULL, 16);
+    }
+
+    fclose(manifest);
+}
+
+
+static int read_file(const char *filename, uint8_t *buffer, size_t capacity, size_t *length) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return FALSE;
+    }
+    *length = fread(buffer, 1, capacity, file);
+    fclose(file);
+    return TRUE;
+}
+
+
+// Returns the number of events, or -1 if the movie could not be read
+static int read_movie(const char *movie_filename, MovieEvent *events) {
+    FILE *movie = fopen(movie_filename, "r");
+    if (movie == NULL) {
+        return -1;
+    }
+
+    char text[128];
+    int count = 0;
+    while (fgets(text, sizeof(text), movie) != NULL && count < MAX_MOVIE_EVENTS) {
+        unsigned keys;
+        if (text[0] != '#' && sscanf(text, "%i %x", &events[count].frame, &keys) == 2) {
+            events[count++].keys = keys;
+        }
+    }
+
+    fclose(movie);
+    return count;
+}
+
+
+// Writes the screens as panels side by side, separated by a column of set pixels
+static void write_pbm(const char *filename, const uint8_t (*panels[])[SCREEN_WIDTH], int panel_count) {
+    FILE *pbm = fopen(filename, "w");
+    if (pbm == NULL) {
+        return;
+    }
+
+    fprintf(pbm, "P1\n%i %i\n", panel_count * (SCREEN_WIDTH + 1) - 1, SCREEN_HEIGHT);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int p = 0; p < panel_count; p++) {
+            if (p > 0) {fputs("1 ", pbm);}
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                fputs(panels[p][y][x] ? "1 " : "0 ", pbm);
+            }
+        }
+        fputc('\n', pbm);
+    }
+    fclose(pbm);
+}
+
+
+// Reads a golden image written by write_pbm with a single panel
+static int read_pbm(const char *filename, uint8_t screen[SCREEN_HEIGHT][SCREEN_WIDTH]) {
+    FILE *pbm = fopen(filename, "r");
+    int width, height;
+
+    if (pbm == NULL) {
+        return FALSE;
+    }
+    if (fscanf(pbm, "P1 %i %i", &width, &height) != 2 || width != SCREEN_WIDTH || height != SCREEN_HEIGHT) {
+        fclose(pbm);
+        return FALSE;
+    }
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            int pixel;
+            if (fscanf(pbm, "%1i", &pixel) != 1) {
+                fclose(pbm);
+                return FALSE;
+            }
+            screen[y][x] = pixel;
+        }
+    }
+    fclose(pbm);
+    return TRUE;
+}
+
+
+static void save_golden(const Check *check, const Chip8 *chip8) {
+    char path[MAX_OUTPUT_PATH];
+    const uint8_t (*panels[1])[SCREEN_WIDTH] = {chip8->screen};
+
+    golden_path(check, path);
+    write_pbm(path, panels, 1);
+}
+
+
+// Writes golden | actual | difference for a failed screen check
+static void dump_mismatch(const Check *check, const Chip8 *chip8) {
+    static uint8_t golden[SCREEN_HEIGHT][SCREEN_WIDTH];
+    static uint8_t difference[SCREEN_HEIGHT][SCREEN_WIDTH];
+    char path[MAX_OUTPUT_PATH];
+
+    golden_path(check, path);
+    int has_golden = read_pbm(path, golden);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            difference[y][x] = golden[y][x] ^ chip8->screen[y][x];
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s-line%i-frame%i.pbm", base_name(check->rom), check->line, check->frame);
+    if (has_golden) {
+        const uint8_t (*panels[3])[SCREEN_WIDTH] = {golden, chip8->screen, difference};
+        write_pbm(path, panels, 3);
+    }
+    else {
+        const uint8_t (*panels[1])[SCREEN_WIDTH] = {chip8->screen};
+        write_pbm(path, panels, 1);
+    }
+}
+
+
+/*
+* Runs a rom once up to the last frame any of its checks needs and
+* records the hash of every check of the same rom, quirks and movie
+*/
+static void run_job(int first, const int *job_of, CheckResult *results, int update) {
+    static Chip8 chip8;
+    static uint8_t rom[TOTAL_RAM];
+    static MovieEvent events[MAX_MOVIE_EVENTS];
+    const Check *job = &checks[first];
+    size_t rom_length;
+    int event_count = 0;
+    int last_frame = 0;
+
+    for (int i = first; i < check_count; i++) {
+        if (job_of[i] == first && checks[i].frame > last_frame) {last_frame = checks[i].frame;}
+    }
+
+    if (!read_file(job->rom, rom, sizeof(rom), &rom_length) || !chip8_load(&chip8, rom, rom_length) ||
+        (job->movie[0] != '\0' && (event_count = read_movie(job->movie, events)) < 0)) {
+        for (int i = first; i < check_count; i++) {
+            if (job_of[i] == first) {results[i].status = CHECK_ERROR;}
+        }
+        return;
+    }
+    chip8.quirks = job->quirks;
+    seed_random(&chip8, RNG_SEED);
+
+    int next_event = 0;
+    for (int frame = 0; frame <= last_frame; frame++) {
+        while (next_event < event_count && events[next_event].frame <= frame) {
+            chip8_set_keys(&chip8, events[next_event++].keys);
+        }
+
+        for (int i = first; i < check_count; i++) {
+            if (job_of[i] != first || checks[i].frame != frame) {
+                continue;
+            }
+            results[i].actual = hash_state(&chip8, checks[i].kind);
+            if (update) {
+                results[i].status = CHECK_PASSED;
+                if (checks[i].kind & HASH_SCREEN) {save_golden(&checks[i], &chip8);}
+            }
+            else if (checks[i].has_expected && results[i].actual == checks[i].expected) {
+                results[i].status = CHECK_PASSED;
+            }
+            else {
+                results[i].status = CHECK_FAILED;
+                if (checks[i].kind & HASH_SCREEN) {dump_mismatch(&checks[i], &chip8);}
+            }
+        }
+
+        if (frame < last_frame && chip8_step_frames(&chip8, 1, NULL, NULL) == 0) {
+            break;
+        }
+    }
+
+    for (int i = first; i < check_count; i++) {
+        if (job_of[i] == first && results[i].status == CHECK_PENDING) {results[i].status = CHECK_ERROR;}
+    }
+}
+
+
+// Replaces the hash column of every check line in the manifest
+static void update_manifest(const char *manifest_filename, const CheckResult *results) {
+    static char lines[MAX_CHECKS * 4][1024];
+    int line_count = 0;
+
+    FILE *manifest = fopen(manifest_filename, "r");
+    while (line_count < MAX_CHECKS * 4 && fgets(lines[line_count], sizeof(lines[0]), manifest) != NULL) {
+        line_count++;
+    }
+    fclose(manifest);
+
+    manifest = fopen(manifest_filename, "w");
+    int c = 0;
+    for (int line = 1; line <= line_count; line++) {
+        if (c < check_count && checks[c].line == line && results[c].status != CHECK_PASSED) {
+            fputs(lines[line - 1], manifest);      // keep the old hash of a check that did not run
+            c++;
+        }
+        else if (c < check_count && checks[c].line == line) {
+            // Swap the hash in place so the columns and any comment stay as they were
+            char rom[MAX_NAME], quirks[32], movie[MAX_NAME], kind[16];
+            int frame, hash_start = 0;
+            const char *text = lines[line - 1];
+            sscanf(text, "%255s %31s %255s %i %15s %n", rom, quirks, movie, &frame, kind, &hash_start);
+            size_t hash_length = strcspn(text + hash_start, " \t\r\n#");
+            fprintf(manifest, "%.*s%016llx%s", hash_start, text, (unsigned long long)results[c].actual,
+                text + hash_start + hash_length);
+            c++;
+        }
+        else {
+            fputs(lines[line - 1], manifest);
+        }
+    }
+    fclose(manifest);
+}
+
+
+int main(int argc, char *argv[]) {
+    static int job_of[MAX_CHECKS];
+    int update = argc > 2 && strcmp(argv[2], "update") == 0;
+
+    if (argc < 2) {
+        printf("Program Usage: ./chip8-regress path/to/manifest [update]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    read_manifest(argv[1]);
+    if (update) {
+        char golden_dir[MAX_NAME + 8];
+        snprintf(golden_dir, sizeof(golden_dir), "%sgolden", manifest_dir);
+        mkdir(golden_dir, 0755);
+    }
+
+    // Checks of the same rom, quirks and movie share one run, job_of is the index of its first check
+    for (int i = 0; i < check_count; i++) {
+        job_of[i] = i;
+        for (int j = 0; j < i; j++) {
+            if (strcmp(checks[i].rom, checks[j].rom) == 0 && strcmp(checks[i].movie, checks[j].movie) == 0 &&
+                checks[i].quirks == checks[j].quirks) {
+                job_of[i] = job_of[j];
+                break;
+            }
+        }
+    }
+
+    CheckResult *results = mmap(NULL, sizeof(CheckResult) * MAX_CHECKS, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        perror("ERROR: Could not map shared memory");
+        exit(EXIT_FAILURE);
+    }
+    memset(results, 0, sizeof(CheckResult) * MAX_CHECKS);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // One worker process per job, at most one per core at a time
+    long max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = 0;
+    for (int i = 0; i < check_count; i++) {
+        if (job_of[i] != i) {
+            continue;
+        }
+        if (workers == max_workers) {
+            wait(NULL);
+            workers--;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_job(i, job_of, results, update);
+            _exit(0);
+        }
+        if (pid < 0) {
+            run_job(i, job_of, results, update);
+        }
+        else {
+            workers++;
+        }
+    }
+    while (workers > 0) {
+        wait(NULL);
+        workers--;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    int failed = 0;
+    for (int i = 0; i < check_count; i++) {
+        const Check *check = &checks[i];
+        const CheckResult *result = &results[i];
+
+        if (result->status == CHECK_PASSED) {
+            continue;
+        }
+        failed++;
+        if (result->status == CHECK_ERROR || result->status == CHECK_PENDING) {
+            printf("ERROR  line %i: %s did not reach frame %i\n", check->line, check->rom, check->frame);
+        }
+        else {
+            printf("FAIL   line %i: %s frame %i expected %016llx actual %016llx\n", check->line, check->rom,
+                check->frame, (unsigned long long)check->expected, (unsigned long long)result->actual);
+        }
+    }
+
+    if (update) {
+        update_manifest(argv[1], results);
+        printf("Updated %i checks (%i errors) in %.2f s\n", check_count - failed, failed, elapsed);
+    }
+    else {
+        printf("%i checks, %i failed in %.2f s\n", check_count, failed, elapsed);
+    }
+
+    munmap(results, sizeof(CheckResult) * MAX_CHECKS);
+    return failed > 0 ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,66 @@
+/*
+* Shared memory frame viewer
+*
+* Attaches to the shared memory segment published by the emulator
+* (./chip8 path/to/rom shm=/name) and prints every new frame as text.
+*
+* Example: <unix> ./chip8-shm-view /chip8 [frames]
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "shared_frame.h"
+
+#define POLL_INTERVAL_NS 4000000        // 4 ms
+
+
+int main(int argc, char *argv[]) {
+    static SharedFrame copy;
+    struct timespec interval = {0, POLL_INTERVAL_NS};
+    uint32_t last_frame = 0;
+    long frames_left = -1;
+
+    if (argc < 2) {
+        printf("Program Usage: ./chip8-shm-view /name [frames]\n");
+        exit(EXIT_FAILURE);
+    }
+    if (argc > 2) {
+        frames_left = atol(argv[2]);
+    }
+
+    const SharedFrame *frame = attach_shared_frame(argv[1]);
+    if (frame == NULL) {
+        printf("ERROR: No chip8 frame published at %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    while (frames_left != 0) {
+        copy_shared_frame(frame, &copy);
+
+        if (copy.frame_number == last_frame) {
+            nanosleep(&interval, NULL);
+            continue;
+        }
+        last_frame = copy.frame_number;
+
+        printf("\033[H\033[2JFrame %u  PC 0x%03X  I 0x%03X  SP %u  DT %u  ST %u\n", copy.frame_number,
+            copy.pc_reg, copy.I_reg, copy.sp_reg, copy.delay_timer, copy.sound_timer);
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                putchar(copy.screen[y][x] ? '#' : ' ');
+            }
+            putchar('\n');
+        }
+        fflush(stdout);
+
+        if (frames_left > 0) {
+            frames_left--;
+        }
+    }
+
+    detach_shared_frame(frame);
+    return 0;
+}
@@ -0,0 +1,332 @@
+/*
+* Chip8 Recording Exporter
+*
+* Reads a recording made with the emulator's record option (.c8v, see
+* src/video.h) and prints its size, or exports it as an animated GIF or
+* as one PBM image per frame.
+*
+* Example: <unix> ./chip8-video game.c8v
+*          <unix> ./chip8-video game.c8v gif game.gif [SCALE]
+*          <unix> ./chip8-video game.c8v pbm frames/game
+*
+* GIF frames only cover the part of the screen that changed. Viewers slow
+* down delays under 2 cs, frames shown for less than that are merged into
+* the next one (the later screen wins).
+*
+* PBM frames are written as PREFIX_000000.pbm and so on, pixels that are on
+* are 1 (black in most viewers).
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "video.h"
+
+#define DEFAULT_SCALE 8
+#define MAX_SCALE 16
+#define GIF_MIN_DELAY 2             // centiseconds
+#define GIF_LAST_DELAY 100          // the last frame stays for a second
+#define LZW_MIN_CODE_SIZE 2         // the smallest GIF allows, for 2 colours
+#define LZW_MAX_CODE 4095
+
+typedef struct {
+    FILE *file;
+    uint8_t block[255];             // data sub-block being filled
+    int block_length;
+    uint32_t bits;
+    int bit_count;
+} GifOutput;
+
+
+static void open_reader(VideoReader *reader, const char *path) {
+    if (!open_video_reader(reader, path)) {
+        printf("ERROR: %s is not a recording\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+// Reads the next frame, exits on a damaged file
+static int next_frame(VideoReader *reader) {
+    int result = read_video_frame(reader);
+    if (result < 0) {
+        printf("ERROR: Recording is damaged after frame %u\n", reader->frames);
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+
+static void unpack_screen(const uint8_t *packed, uint8_t *pixels) {
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        pixels[i] = (packed[i / 8] >> (7 - i % 8)) & 1;
+    }
+}
+
+
+static void put_u16(FILE *file, unsigned value) {
+    fputc(value & 0xFF, file);
+    fputc(value >> 8, file);
+}
+
+
+static void flush_block(GifOutput *out) {
+    if (out->block_length > 0) {
+        fputc(out->block_length, out->file);
+        fwrite(out->block, 1, out->block_length, out->file);
+        out->block_length = 0;
+    }
+}
+
+
+// Codes are packed least significant bit first into 255 byte sub-blocks
+static void put_code(GifOutput *out, unsigned code, int size) {
+    out->bits |= code << out->bit_count;
+    out->bit_count += size;
+
+    while (out->bit_count >= 8) {
+        out->block[out->block_length++] = out->bits & 0xFF;
+        out->bits >>= 8;
+        out->bit_count -= 8;
+        if (out->block_length == 255) {flush_block(out);}
+    }
+}
+
+
+/*
+* LZW compresses the colour indices of an image into GIF data sub-blocks.
+* The table is a trie, child[code][index] is the code of the string code
+* followed by index (0 if it is not in the table yet)
+*/
+static void write_lzw(FILE *file, const uint8_t *indices, size_t count) {
+    static uint16_t child[LZW_MAX_CODE + 1][1 << LZW_MIN_CODE_SIZE];
+    const unsigned clear_code = 1 << LZW_MIN_CODE_SIZE;
+    const unsigned end_code = clear_code + 1;
+    GifOutput out = {file, {0}, 0, 0, 0};
+
+    memset(child, 0, sizeof(child));
+    unsigned last_code = end_code;
+    int code_size = LZW_MIN_CODE_SIZE + 1;
+    unsigned current = indices[0];
+
+    fputc(LZW_MIN_CODE_SIZE, file);
+    put_code(&out, clear_code, code_size);
+
+    for (size_t i = 1; i < count; i++) {
+        if (child[current][indices[i]] != 0) {
+            current = child[current][indices[i]];
+            continue;
+        }
+
+        put_code(&out, current, code_size);
+        child[current][indices[i]] = ++last_code;
+        if (last_code >= (1u << code_size)) {code_size++;}
+
+        // Table full, start over
+        if (last_code == LZW_MAX_CODE) {
+            put_code(&out, clear_code, code_size);
+            memset(child, 0, sizeof(child));
+            code_size = LZW_MIN_CODE_SIZE + 1;
+            last_code = end_code;
+        }
+        current = indices[i];
+    }
+
+    put_code(&out, current, code_size);
+    put_code(&out, clear_code, code_size);
+    put_code(&out, end_code, LZW_MIN_CODE_SIZE + 1);
+    if (out.bit_count > 0) {put_code(&out, 0, 8 - out.bit_count);}
+    flush_block(&out);
+    fputc(0, file);
+}
+
+
+static void write_gif_header(FILE *file, int scale) {
+    static const uint8_t palette[6] = {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF};
+
+    fwrite("GIF89a", 1, 6, file);
+    put_u16(file, SCREEN_WIDTH * scale);
+    put_u16(file, SCREEN_HEIGHT * scale);
+    fputc(0x80, file);                              // 2 colour global table
+    fputc(0, file);
+    fputc(0, file);
+    fwrite(palette, 1, sizeof(palette), file);
+
+    // Loop forever
+    fputc(0x21, file);
+    fputc(0xFF, file);
+    fputc(11, file);
+    fwrite("NETSCAPE2.0", 1, 11, file);
+    fputc(3, file);
+    fputc(1, file);
+    put_u16(file, 0);
+    fputc(0, file);
+}
+
+
+/*
+* Writes the pixels that differ from shown (the screen of the frames
+* written so far) as a frame that stays for delay centiseconds
+*/
+static void write_gif_frame(FILE *file, const uint8_t *pixels, uint8_t *shown, int scale, unsigned delay, int first) {
+    static uint8_t indices[SCREEN_WIDTH * SCREEN_HEIGHT * MAX_SCALE * MAX_SCALE];
+    int left = SCREEN_WIDTH, right = -1, top = SCREEN_HEIGHT, bottom = -1;
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            if (first || pixels[y * SCREEN_WIDTH + x] != shown[y * SCREEN_WIDTH + x]) {
+                if (x < left) {left = x;}
+                if (x > right) {right = x;}
+                if (y < top) {top = y;}
+                if (y > bottom) {bottom = y;}
+            }
+        }
+    }
+    // Nothing changed, a single pixel still carries the delay
+    if (right < 0) {
+        left = right = top = bottom = 0;
+    }
+
+    int width = (right - left + 1) * scale;
+    int height = (bottom - top + 1) * scale;
+    size_t count = 0;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = &pixels[(top + y / scale) * SCREEN_WIDTH + left];
+        for (int x = 0; x < width; x++) {
+            indices[count++] = row[x / scale];
+        }
+    }
+    memcpy(shown, pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    // Graphic control: leave the frame in place, delay
+    fputc(0x21, file);
+    fputc(0xF9, file);
+    fputc(4, file);
+    fputc(1 << 2, file);
+    put_u16(file, delay);
+    fputc(0, file);
+    fputc(0, file);
+
+    fputc(0x2C, file);
+    put_u16(file, left * scale);
+    put_u16(file, top * scale);
+    put_u16(file, width);
+    put_u16(file, height);
+    fputc(0, file);
+
+    write_lzw(file, indices, count);
+}
+
+
+// 60 Hz frame number to centiseconds, rounded down so the delays add up without drift
+static unsigned frame_centiseconds(uint32_t frame_number) {
+    return (unsigned)((uint64_t)frame_number * 100 / 60);
+}
+
+
+static void export_gif(const char *path, const char *gif_path, int scale) {
+    static uint8_t held[SCREEN_WIDTH * SCREEN_HEIGHT];
+    static uint8_t shown[SCREEN_WIDTH * SCREEN_HEIGHT];
+    VideoReader reader;
+
+    open_reader(&reader, path);
+    FILE *file = fopen(gif_path, "wb");
+    if (file == NULL) {
+        printf("ERROR: Could not create %s\n", gif_path);
+        exit(EXIT_FAILURE);
+    }
+
+    write_gif_header(file, scale);
+
+    // A frame is written once the next one says how long it stays
+    int written = 0;
+    if (next_frame(&reader)) {
+        unpack_screen(reader.screen, held);
+        unsigned held_start = frame_centiseconds(reader.frame_number);
+
+        while (next_frame(&reader)) {
+            unsigned start = frame_centiseconds(reader.frame_number);
+            if (start - held_start >= GIF_MIN_DELAY) {
+                write_gif_frame(file, held, shown, scale, start - held_start, written == 0);
+                written++;
+                held_start = start;
+            }
+            unpack_screen(reader.screen, held);
+        }
+        write_gif_frame(file, held, shown, scale, GIF_LAST_DELAY, written == 0);
+        written++;
+    }
+
+    fputc(0x3B, file);
+    if (fclose(file) != 0) {
+        printf("ERROR: Could not write %s\n", gif_path);
+        exit(EXIT_FAILURE);
+    }
+    printf("%u frames, %i written to %s\n", reader.frames, written, gif_path);
+    close_video_reader(&reader);
+}
+
+
+static void export_pbm(const char *path, const char *prefix) {
+    char pbm_path[4096];
+    VideoReader reader;
+
+    open_reader(&reader, path);
+    while (next_frame(&reader)) {
+        snprintf(pbm_path, sizeof(pbm_path), "%s_%06u.pbm", prefix, reader.frames - 1);
+        FILE *file = fopen(pbm_path, "wb");
+        if (file == NULL) {
+            printf("ERROR: Could not create %s\n", pbm_path);
+            exit(EXIT_FAILURE);
+        }
+
+        // Binary PBM rows are packed like the recording, MSb first
+        fprintf(file, "P4\n# frame %u\n%i %i\n", reader.frame_number, SCREEN_WIDTH, SCREEN_HEIGHT);
+        fwrite(reader.screen, 1, VIDEO_FRAME_SIZE, file);
+        if (fclose(file) != 0) {
+            printf("ERROR: Could not write %s\n", pbm_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("%u frames written to %s_*.pbm\n", reader.frames, prefix);
+    close_video_reader(&reader);
+}
+
+
+static void print_info(const char *path) {
+    VideoReader reader;
+
+    open_reader(&reader, path);
+    while (next_frame(&reader)) {}
+
+    long size = ftell(reader.file);
+    unsigned long raw_size = (unsigned long)reader.frames * VIDEO_FRAME_SIZE;
+    printf("%u frames over %.1f s\n", reader.frames, reader.frame_number / 60.0);
+    printf("%ld bytes, %.1f bytes per frame (%.1f%% of the packed frames)\n", size,
+           reader.frames > 0 ? (double)size / reader.frames : 0.0,
+           raw_size > 0 ? 100.0 * size / raw_size : 0.0);
+    close_video_reader(&reader);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc == 2) {
+        print_info(argv[1]);
+    }
+    else if (argc >= 4 && strcmp(argv[2], "gif") == 0) {
+        int scale = argc > 4 ? atoi(argv[4]) : DEFAULT_SCALE;
+        if (scale < 1 || scale > MAX_SCALE) {
+            printf("ERROR: Scale has to be 1 to %i\n", MAX_SCALE);
+            exit(EXIT_FAILURE);
+        }
+        export_gif(argv[1], argv[3], scale);
+    }
+    else if (argc == 4 && strcmp(argv[2], "pbm") == 0) {
+        export_pbm(argv[1], argv[3]);
+    }
+    else {
+        printf("Program Usage: ./chip8-video recording.c8v [gif out.gif [SCALE] | pbm out/prefix]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
@@ -0,0 +1,650 @@
+/*
+* Chip8 Emulator Service
+*
+* Hosts emulator sessions for other processes over a Unix domain socket,
+* so they share one running host instead of each starting an emulator.
+* Connections are spread over a fixed pool of worker threads, each serving
+* its connections from an epoll loop. A session belongs to the connection
+* that created it and is destroyed with it, so a session is only ever
+* touched by one worker and needs no locking.
+*
+* Example: <unix> ./chip8d /tmp/chip8d.sock [workers=N]
+*
+* Every request and response is a 4 byte length (of what follows) and a
+* type or status byte, then the fields below. Numbers are little endian,
+* session ids are per connection and never 0.
+*
+*   type  request                         response payload (status 0)
+*   1     create: quirks u8, seed u32, rom    id u32
+*   2     set keys: id u32, keys u16          -
+*   3     step: id u32, frames u32            frames run u32, running u8, error u8
+*   4     screen: id u32                      PACKED_SCREEN_SIZE bytes, 8 pixels a byte, MSb first
+*   5     state: id u32                       V 16 bytes, I u16, pc u16, sp u8, delay u8,
+*                                             sound u8, running u8, error u8, keys u16,
+*                                             state hash u64
+*   6     snapshot: id u32                    id u32 of a new session, a copy of the session
+*   7     restore: id u32, from id u32        - (the session becomes a copy of from)
+*   8     destroy: id u32                     -
+*
+* Status: 0 ok, 1 bad request, 2 no such session, 3 rom too large, 4 out of memory.
+* A request longer than MAX_REQUEST closes the connection.
+*
+* Snapshots and restores copy the whole session (chip8_fork).
+*
+* Every worker allocates its sessions from a pool of its own (src/pool.h),
+* on huge pages the worker touches first. On machines with more than one
+* NUMA node the workers are spread over the nodes and pinned to the cpus of
+* theirs, so sessions are run by the node that holds their memory.
+*/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "api.h"
+#include "pool.h"
+
+#define MAX_REQUEST (4 + 1 + 5 + PROGRAM_END_ADDR - PROGRAM_START_ADDR)    // a create with the largest rom
+#define MAX_RESPONSE 512
+#define MAX_PENDING_OUTPUT (1 << 20)        // stop reading requests from a client that does not read its responses
+#define MAX_STEP_FRAMES 3600
+#define MAX_EVENTS 64
+#define MAX_NODES 64
+
+typedef enum {
+    REQUEST_CREATE = 1,
+    REQUEST_SET_KEYS,
+    REQUEST_STEP,
+    REQUEST_SCREEN,
+    REQUEST_STATE,
+    REQUEST_SNAPSHOT,
+    REQUEST_RESTORE,
+    REQUEST_DESTROY
+} RequestType;
+
+typedef enum {
+    STATUS_OK,
+    STATUS_BAD_REQUEST,
+    STATUS_NO_SESSION,
+    STATUS_ROM_TOO_LARGE,
+    STATUS_OUT_OF_MEMORY
+} Status;
+
+typedef struct {
+    int fd;
+    uint32_t events;                        // what the worker's epoll waits for
+    Chip8Pool *pool;                        // of the worker that owns the connection
+
+    uint8_t in[MAX_REQUEST];
+    size_t in_length;
+
+    uint8_t *out;
+    size_t out_length;
+    size_t out_capacity;
+    size_t out_sent;
+    size_t response_start;                  // where the length of the response being built goes
+
+    Chip8 **sessions;                       // session id - 1, NULL where destroyed
+    uint32_t session_count;
+    uint32_t session_capacity;
+    uint32_t lowest_free;                   // no free slot below this
+} Connection;
+
+typedef struct {
+    pthread_t thread;
+    int epoll_fd;
+    Chip8Pool pool;
+    int pinned;
+    cpu_set_t cpus;                         // of its NUMA node, if pinned
+} Worker;
+
+static volatile sig_atomic_t stopping = FALSE;
+static uint64_t connections_served = 0;
+static uint64_t sessions_created = 0;
+
+
+static void put_u16(uint8_t *data, uint16_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+
+static void put_u32(uint8_t *data, uint32_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+
+static uint32_t get_u32(const uint8_t *data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+
+// Starts a response, returns where its payload goes (MAX_RESPONSE bytes) or NULL if out of memory
+static uint8_t *begin_response(Connection *connection, Status status) {
+    if (connection->out_length + MAX_RESPONSE > connection->out_capacity) {
+        size_t capacity = connection->out_capacity > 0 ? 2 * connection->out_capacity : 4096;
+        while (connection->out_length + MAX_RESPONSE > capacity) {capacity *= 2;}
+
+        uint8_t *out = realloc(connection->out, capacity);
+        if (out == NULL) {
+            return NULL;
+        }
+        connection->out = out;
+        connection->out_capacity = capacity;
+    }
+
+    connection->response_start = connection->out_length;
+    connection->out[connection->out_length + 4] = status;
+    connection->out_length += 5;
+    return &connection->out[connection->out_length];
+}
+
+
+static void end_response(Connection *connection, size_t payload_length) {
+    connection->out_length += payload_length;
+    put_u32(&connection->out[connection->response_start], connection->out_length - connection->response_start - 4);
+}
+
+
+// Returns FALSE if out of memory
+static int respond(Connection *connection, Status status) {
+    if (begin_response(connection, status) == NULL) {
+        return FALSE;
+    }
+    end_response(connection, 0);
+    return TRUE;
+}
+
+
+static Chip8 *find_session(const Connection *connection, uint32_t id) {
+    return id > 0 && id <= connection->session_count ? connection->sessions[id - 1] : NULL;
+}
+
+
+// Gives the system a session id, returns 0 if out of memory
+static uint32_t add_session(Connection *connection, Chip8 *chip8) {
+    uint32_t slot = connection->lowest_free;
+    while (slot < connection->session_count && connection->sessions[slot] != NULL) {
+        slot++;
+    }
+
+    if (slot == connection->session_capacity) {
+        uint32_t capacity = connection->session_capacity > 0 ? 2 * connection->session_capacity : 16;
+        Chip8 **sessions = realloc(connection->sessions, capacity * sizeof(Chip8 *));
+        if (sessions == NULL) {
+            return 0;
+        }
+        connection->sessions = sessions;
+        connection->session_capacity = capacity;
+    }
+    if (slot == connection->session_count) {
+        connection->session_count++;
+    }
+
+    connection->sessions[slot] = chip8;
+    connection->lowest_free = slot + 1;
+    __atomic_add_fetch(&sessions_created, 1, __ATOMIC_RELAXED);
+    return slot + 1;
+}
+
+
+static void remove_session(Connection *connection, uint32_t id) {
+    pool_free(connection->pool, connection->sessions[id - 1]);
+    connection->sessions[id - 1] = NULL;
+    if (id - 1 < connection->lowest_free) {connection->lowest_free = id - 1;}
+}
+
+
+static Status create_session(Connection *connection, const uint8_t *request, size_t length, uint32_t *id) {
+    if (length < 5) {
+        return STATUS_BAD_REQUEST;
+    }
+
+    Chip8 *chip8 = pool_alloc(connection->pool);
+    if (chip8 == NULL) {
+        return STATUS_OUT_OF_MEMORY;
+    }
+    if (!chip8_load(chip8, request + 5, length - 5)) {
+        pool_free(connection->pool, chip8);
+        return STATUS_ROM_TOO_LARGE;
+    }
+    chip8->quirks = request[0];
+    seed_random(chip8, get_u32(request + 1));
+
+    *id = add_session(connection, chip8);
+    if (*id == 0) {
+        pool_free(connection->pool, chip8);
+        return STATUS_OUT_OF_MEMORY;
+    }
+    return STATUS_OK;
+}
+
+
+// A new session that is a copy of chip8, returns 0 if out of memory
+static uint32_t snapshot_session(Connection *connection, Chip8 *chip8) {
+    Chip8 *copy = pool_alloc(connection->pool);
+    if (copy == NULL) {
+        return 0;
+    }
+    chip8_fork(chip8, copy);
+
+    uint32_t id = add_session(connection, copy);
+    if (id == 0) {pool_free(connection->pool, copy);}
+    return id;
+}
+
+
+/*
+* Runs one request (type byte and fields) and appends its response.
+* Returns FALSE if the connection has to be closed
+*/
+static int handle_request(Connection *connection, const uint8_t *request, size_t length) {
+    uint8_t type = request[0];
+    request++;
+    length--;
+
+    if (type == REQUEST_CREATE) {
+        uint32_t id = 0;
+        Status status = create_session(connection, request, length, &id);
+        uint8_t *payload = begin_response(connection, status);
+        if (payload == NULL) {return FALSE;}
+
+        put_u32(payload, id);
+        end_response(connection, status == STATUS_OK ? 4 : 0);
+        return TRUE;
+    }
+
+    if (length < 4 || type < REQUEST_SET_KEYS || type > REQUEST_DESTROY) {
+        return respond(connection, STATUS_BAD_REQUEST);
+    }
+    uint32_t id = get_u32(request);
+    Chip8 *chip8 = find_session(connection, id);
+    if (chip8 == NULL) {
+        return respond(connection, STATUS_NO_SESSION);
+    }
+
+    switch (type) {
+        case REQUEST_SET_KEYS:
+            if (length < 6) {return respond(connection, STATUS_BAD_REQUEST);}
+            chip8_set_keys(chip8, request[4] | request[5] << 8);
+            return respond(connection, STATUS_OK);
+
+        case REQUEST_STEP: {
+            if (length < 8 || get_u32(request + 4) > MAX_STEP_FRAMES) {return respond(connection, STATUS_BAD_REQUEST);}
+            uint32_t frames = chip8_step_frames(chip8, get_u32(request + 4), NULL, NULL);
+
+            uint8_t *payload = begin_response(connection, STATUS_OK);
+            if (payload == NULL) {return FALSE;}
+            put_u32(payload, frames);
+            payload[4] = chip8->is_running_flag;
+            payload[5] = chip8->error;
+            end_response(connection, 6);
+            return TRUE;
+        }
+
+        case REQUEST_SCREEN: {
+            uint8_t *payload = begin_response(connection, STATUS_OK);
+            if (payload == NULL) {return FALSE;}
+            chip8_get_screen_packed(chip8, payload);
+            end_response(connection, PACKED_SCREEN_SIZE);
+            return TRUE;
+        }
+
+        case REQUEST_STATE: {
+            uint8_t *payload = begin_response(connection, STATUS_OK);
+            if (payload == NULL) {return FALSE;}
+
+            memcpy(payload, chip8->V, NUM_V_REGISTERS);
+            put_u16(payload + 16, chip8->I_reg);
+            put_u16(payload + 18, chip8->pc_reg);
+            payload[20] = chip8->sp_reg;
+            payload[21] = chip8->delay_timer;
+            payload[22] = chip8->sound_timer;
+            payload[23] = chip8->is_running_flag;
+            payload[24] = chip8->error;
+            put_u16(payload + 25, chip8_get_keys(chip8));
+            uint64_t hash = chip8_state_hash(chip8);
+            put_u32(payload + 27, hash);
+            put_u32(payload + 31, hash >> 32);
+            end_response(connection, 35);
+            return TRUE;
+        }
+
+        case REQUEST_SNAPSHOT: {
+            uint32_t copy_id = snapshot_session(connection, chip8);
+            uint8_t *payload = begin_response(connection, copy_id != 0 ? STATUS_OK : STATUS_OUT_OF_MEMORY);
+            if (payload == NULL) {return FALSE;}
+            put_u32(payload, copy_id);
+            end_response(connection, copy_id != 0 ? 4 : 0);
+            return TRUE;
+        }
+
+        case REQUEST_RESTORE: {
+            if (length < 8) {return respond(connection, STATUS_BAD_REQUEST);}
+            Chip8 *source = find_session(connection, get_u32(request + 4));
+            if (source == NULL) {return respond(connection, STATUS_NO_SESSION);}
+            if (source != chip8) {chip8_fork(source, chip8);}
+            return respond(connection, STATUS_OK);
+        }
+
+        case REQUEST_DESTROY:
+            remove_session(connection, id);
+            return respond(connection, STATUS_OK);
+
+        default:
+            return respond(connection, STATUS_BAD_REQUEST);
+    }
+}
+
+
+static void close_connection(Connection *connection) {
+    for (uint32_t i = 0; i < connection->session_count; i++) {
+        if (connection->sessions[i] != NULL) {pool_free(connection->pool, connection->sessions[i]);}
+    }
+    close(connection->fd);
+    free(connection->sessions);
+    free(connection->out);
+    free(connection);
+}
+
+
+// Runs the complete requests in the input buffer, returns FALSE if the connection has to be closed
+static int handle_requests(Connection *connection) {
+    size_t start = 0;
+
+    while (connection->in_length - start >= 4) {
+        uint32_t length = get_u32(&connection->in[start]);
+        if (length == 0 || length > MAX_REQUEST - 4) {
+            return FALSE;
+        }
+        if (connection->in_length - start < 4 + length) {
+            break;
+        }
+        if (!handle_request(connection, &connection->in[start + 4], length)) {
+            return FALSE;
+        }
+        start += 4 + length;
+    }
+
+    memmove(connection->in, &connection->in[start], connection->in_length - start);
+    connection->in_length -= start;
+    return TRUE;
+}
+
+
+// Sends what the socket takes of the responses, returns FALSE if the connection is gone
+static int send_responses(Connection *connection) {
+    while (connection->out_sent < connection->out_length) {
+        ssize_t sent = send(connection->fd, &connection->out[connection->out_sent],
+                            connection->out_length - connection->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection->out_sent += sent;
+    }
+
+    connection->out_length = 0;
+    connection->out_sent = 0;
+    return TRUE;
+}
+
+
+// Reads while the socket has data, returns FALSE if the connection was closed or broke
+static int receive_requests(Connection *connection) {
+    for (;;) {
+        ssize_t received = recv(connection->fd, &connection->in[connection->in_length],
+                                MAX_REQUEST - connection->in_length, 0);
+        if (received == 0) {
+            return FALSE;
+        }
+        if (received < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        connection->in_length += received;
+        if (!handle_requests(connection)) {
+            return FALSE;
+        }
+        if (connection->out_length - connection->out_sent > MAX_PENDING_OUTPUT) {
+            return TRUE;
+        }
+    }
+}
+
+
+// Waits for output space while responses are pending, and for requests unless too many are
+static int update_events(Worker *worker, Connection *connection) {
+    size_t pending = connection->out_length - connection->out_sent;
+    uint32_t events = (pending > 0 ? EPOLLOUT : 0) | (pending <= MAX_PENDING_OUTPUT ? EPOLLIN : 0);
+
+    if (events != connection->events) {
+        struct epoll_event event = {.events = events, .data.ptr = connection};
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event) != 0) {
+            return FALSE;
+        }
+        connection->events = events;
+    }
+    return TRUE;
+}
+
+
+static void *run_worker(void *data) {
+    Worker *worker = data;
+    struct epoll_event events[MAX_EVENTS];
+
+    // Before the first session, so the pool's arenas are touched on the node
+    if (worker->pinned && pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &worker->cpus) != 0) {
+        printf("WARNING: Could not pin a worker to its NUMA node\n");
+    }
+    init_pool(&worker->pool);
+
+    for (;;) {
+        int count = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            perror("ERROR: epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < count; i++) {
+            Connection *connection = events[i].data.ptr;
+            int open = TRUE;
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                open = receive_requests(connection);
+            }
+            open = open && send_responses(connection) && update_events(worker, connection);
+            if (!open) {
+                close_connection(connection);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+// Reads a sysfs cpu list such as "0-3,8-11" into cpus, returns FALSE if there is none
+static int read_cpu_list(const char *path, cpu_set_t *cpus) {
+    char list[4096];
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return FALSE;
+    }
+    size_t length = fread(list, 1, sizeof(list) - 1, file);
+    fclose(file);
+    list[length] = '\0';
+
+    CPU_ZERO(cpus);
+    char *cursor = list;
+    while (*cursor >= '0' && *cursor <= '9') {
+        long first = strtol(cursor, &cursor, 10);
+        long last = *cursor == '-' ? strtol(cursor + 1, &cursor, 10) : first;
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*cursor == ',') {cursor++;}
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+
+/*
+* Reads the cpus of the NUMA nodes that have any (memory only nodes are
+* left out), returns how many were found, 0 if the kernel does not say
+*/
+static int read_numa_nodes(cpu_set_t *nodes) {
+    char path[64];
+    int count = 0;
+
+    for (int node = 0; node < MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%i/cpulist", node);
+        if (read_cpu_list(path, &nodes[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+static void stop_service(int signal_number) {
+    (void)signal_number;
+    stopping = TRUE;
+}
+
+
+// Listens on path, a socket left behind by an earlier run is replaced
+static int listen_on(const char *path) {
+    struct sockaddr_un address;
+    struct stat status;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("ERROR: Socket path too long\n");
+        return -1;
+    }
+    if (stat(path, &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            printf("ERROR: %s exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("ERROR: Could not create socket");
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("ERROR: Could not listen on socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int main(int argc, char *argv[]) {
+    long worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc < 2) {
+        printf("Program Usage: ./chip8d path/to/socket [workers=N]\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strncmp(argv[i], "workers=", 8) == 0 && atol(argv[i] + 8) > 0) {
+            worker_count = atol(argv[i] + 8);
+        }
+        else {
+            printf("ERROR: Unrecognized option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (worker_count < 1) {worker_count = 1;}
+
+    // Interrupt accept on SIGINT and SIGTERM so the socket file is removed
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_service;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = listen_on(argv[1]);
+    if (listen_fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    Worker *workers = calloc(worker_count, sizeof(Worker));
+    if (workers == NULL) {
+        printf("ERROR: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // One node needs no pinning, the kernel already keeps memory local
+    static cpu_set_t nodes[MAX_NODES];
+    int node_count = read_numa_nodes(nodes);
+    for (long i = 0; i < worker_count; i++) {
+        if (node_count > 1) {
+            workers[i].pinned = TRUE;
+            workers[i].cpus = nodes[i % node_count];
+        }
+        workers[i].epoll_fd = epoll_create1(0);
+        if (workers[i].epoll_fd < 0 || pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0) {
+            printf("ERROR: Could not start worker %li\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Listening on %s with %li workers", argv[1], worker_count);
+    if (node_count > 1) {printf(" over %i NUMA nodes", node_count);}
+    printf("\n");
+
+    // Connections go to the workers in turn, a worker owns a connection until it closes
+    long next_worker = 0;
+    while (!stopping) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) {perror("ERROR: accept");}
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+
+        Connection *connection = calloc(1, sizeof(Connection));
+        if (connection == NULL) {
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        connection->pool = &workers[next_worker].pool;
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if (epoll_ctl(workers[next_worker].epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            free(connection);
+            continue;
+        }
+        next_worker = (next_worker + 1) % worker_count;
+        connections_served++;
+    }
+
+    close(listen_fd);
+    unlink(argv[1]);
+    printf("Served %llu connections, %llu sessions\n", (unsigned long long)connections_served,
+           (unsigned long long)__atomic_load_n(&sessions_created, __ATOMIC_RELAXED));
+    return 0;
+}
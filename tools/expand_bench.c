@@ -0,0 +1,92 @@
+/*
+* Microbenchmark for the screen to RGBA expansion kernels
+*
+* Compares the original per pixel loop from buffer_graphics against every
+* expansion kernel the host cpu supports, and checks that they all produce
+* the same pixels for the default palette.
+*
+* Example: <unix> ./expand_bench [iterations]
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "expand.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// The loop buffer_graphics used before the expansion kernels
+static void legacy_buffer_graphics(Chip8 *chip8, uint32_t *buffer) {
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint8_t pixel = chip8->screen[y][x];
+            buffer[(y * SCREEN_WIDTH) + x] = (0xFFFFFF00 * pixel) | 0x000000FF;
+        }
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    static Chip8 chip8;
+    static uint32_t expected[SCREEN_HEIGHT * SCREEN_WIDTH];
+    static uint32_t buffer[SCREEN_HEIGHT * SCREEN_WIDTH];
+    const char *kernels[] = {"scalar", "sse2", "avx2"};
+    Palette palette = {DEFAULT_FOREGROUND, DEFAULT_BACKGROUND};
+    int iterations = DEFAULT_ITERATIONS;
+    volatile uint32_t sink = 0;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+
+    srand(1);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            chip8.screen[y][x] = rand() % 2;
+        }
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        legacy_buffer_graphics(&chip8, expected);
+        sink ^= expected[i % (SCREEN_HEIGHT * SCREEN_WIDTH)];
+    }
+    double legacy_time = now_seconds() - start;
+    printf("%-8s %8.1f ns/frame\n", "legacy", legacy_time / iterations * 1e9);
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        ExpandRowFunc kernel = expand_kernel(kernels[k]);
+        if (kernel == NULL) {
+            printf("%-8s unsupported on this cpu\n", kernels[k]);
+            continue;
+        }
+
+        start = now_seconds();
+        for (int i = 0; i < iterations; i++) {
+            kernel(&chip8.screen[0][0], buffer, SCREEN_HEIGHT * SCREEN_WIDTH, palette);
+            sink ^= buffer[i % (SCREEN_HEIGHT * SCREEN_WIDTH)];
+        }
+        double kernel_time = now_seconds() - start;
+
+        int matches = memcmp(buffer, expected, sizeof(buffer)) == 0;
+        printf("%-8s %8.1f ns/frame  %5.2fx  %s\n", kernels[k], kernel_time / iterations * 1e9,
+            legacy_time / kernel_time, matches ? "ok" : "MISMATCH");
+        if (!matches) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("Selected kernel: %s\n", expand_kernel_name());
+    return 0;
+}